@@ -0,0 +1,88 @@
+#ifndef __FRAME_ARENA_H__
+#define __FRAME_ARENA_H__
+
+#include <type_traits>
+
+/*
+Bump allocator for host data that only lives while one frame is recorded, one per frame in flight.
+reset() rewinds it once that frame's fence has signalled, nothing is freed or destructed individually, so only
+trivially destructible types belong in it. A frame that outgrows the block gets overflow chunks from the heap,
+the next reset() folds them into one bigger block, so a steady frame never reaches malloc.
+*/
+class FrameArena {
+private:
+    std::unique_ptr<uint8_t[]> block;
+    size_t capacity = 0;
+    size_t head = 0;
+    std::vector<std::unique_ptr<uint8_t[]>> overflow;
+    size_t overflowBytes = 0;
+    size_t highWater = 0;
+    uint64_t grows = 0;
+
+public:
+    explicit FrameArena(size_t bytes = 64 * 1024) : block(new uint8_t[bytes]), capacity(bytes) {}
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    size_t size() const { return capacity; }
+    size_t peakBytes() const { return highWater; }
+    uint64_t growCount() const { return grows; }
+
+    void* allocate(size_t size, size_t alignment = alignof(std::max_align_t)) {
+        const uintptr_t base = reinterpret_cast<uintptr_t>(block.get());
+        const size_t offset = static_cast<size_t>(align_up<uintptr_t>(base + head, alignment) - base);
+        if (offset + size <= capacity) {
+            head = offset + size;
+            highWater = std::max(highWater, head);
+            return block.get() + offset;
+        }
+
+        overflow.emplace_back(new uint8_t[size + alignment]);
+        overflowBytes += size + alignment;
+        highWater = std::max(highWater, head + overflowBytes);
+        return reinterpret_cast<void*>(align_up<uintptr_t>(reinterpret_cast<uintptr_t>(overflow.back().get()), alignment));
+    }
+
+    // uninitialized storage for count T
+    template <typename T>
+    T* allocateArray(size_t count) {
+        static_assert(std::is_trivially_destructible<T>::value, "frame arena memory is never destructed");
+        return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    void reset() {
+        if (overflowBytes > 0) {
+            capacity = std::max(capacity * 2, capacity + overflowBytes);
+            block.reset(new uint8_t[capacity]);
+            overflow.clear();
+            overflowBytes = 0;
+            grows++;
+        }
+        head = 0;
+    }
+};
+
+// std allocator over a FrameArena, deallocate is a no-op so reserve up front where the size is known
+template <typename T>
+struct FrameAllocator {
+    using value_type = T;
+    FrameArena* arena;
+
+    explicit FrameAllocator(FrameArena& frameArena) : arena(&frameArena) {}
+    template <typename U>
+    FrameAllocator(const FrameAllocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(size_t count) { return static_cast<T*>(arena->allocate(sizeof(T) * count, alignof(T))); }
+    void deallocate(T*, size_t) {}
+
+    template <typename U>
+    bool operator==(const FrameAllocator<U>& other) const { return arena == other.arena; }
+    template <typename U>
+    bool operator!=(const FrameAllocator<U>& other) const { return arena != other.arena; }
+};
+
+template <typename T>
+using FrameVector = std::vector<T, FrameAllocator<T>>;
+
+#endif
@@ -11,6 +11,7 @@ int motionMode = 0;
 bool selectMode = false;
 bool motionFlying = false;
 bool kick = false;
+bool dumpMemory = false;
 double startX = 0;
 double startY = 0;
 
@@ -78,6 +79,9 @@ void readInput_callback(GLFWwindow* window, int key, int scancode, int action, i
 	else if (key == GLFW_KEY_SPACE && action == GLFW_PRESS) {
 		kick = true;
 	}
+	else if (key == GLFW_KEY_F10 && action == GLFW_PRESS) {
+		dumpMemory = true;
+	}
 }
 
 void mouse_cursor_callback(GLFWwindow* window, double xpos, double ypos) {
@@ -33,90 +33,678 @@ uint32_t findMemoryTypePool(VkPhysicalDevice& physicalDevice, VkMemoryPropertyFl
     throw std::runtime_error("failed to find suitable memory type!");
 }
 
-// value pair in buffer hash LUT
-struct AllocationInfo {
-    VkDeviceSize offset;
-    VkDeviceSize size;
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// index of the highest / lowest set bit, v != 0
+inline uint32_t bitScanReverse(uint64_t v) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse64(&index, v);
+    return index;
+#else
+    return 63u - static_cast<uint32_t>(__builtin_clzll(v));
+#endif
+}
+
+inline uint32_t bitScanForward(uint64_t v) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, v);
+    return index;
+#else
+    return static_cast<uint32_t>(__builtin_ctzll(v));
+#endif
+}
+
+/*
+Two level segregated fit allocator over an abstract [0, capacity) range, no Vulkan calls.
+
+    first level  : power of two of the block size
+    second level : SL_COUNT linear steps inside that power of two
+
+Free blocks sit in one list per (fl, sl) cell, two bitmaps find the first non empty cell that is guaranteed to fit
+in O(1). Blocks are kept in address order through their physical neighbours, freeing merges with a free neighbour
+on either side, so free memory never stays fragmented into adjacent pieces. Alignment is handled by over asking
+alignment - 1 bytes and giving the front padding back as its own free block.
+*/
+class TlsfAllocator {
+public:
+    static constexpr uint32_t SL_BITS = 4;
+    static constexpr uint32_t SL_COUNT = 1u << SL_BITS;
+    static constexpr uint32_t FL_COUNT = 64 - SL_BITS + 1;
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+private:
+    struct Node {
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+        uint32_t prevPhysical = NONE;
+        uint32_t nextPhysical = NONE;
+        uint32_t prevFree = NONE;
+        uint32_t nextFree = NONE;
+        bool free = false;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> unusedNodes;
+    uint64_t flBitmap = 0;
+    uint32_t slBitmap[FL_COUNT] = {};
+    uint32_t heads[FL_COUNT][SL_COUNT];
+    VkDeviceSize capacity = 0;
+    VkDeviceSize used = 0;
+    uint32_t liveAllocations = 0;
+
+    static void mapping(VkDeviceSize size, uint32_t& fl, uint32_t& sl) {
+        if (size < SL_COUNT) {
+            fl = 0;
+            sl = static_cast<uint32_t>(size);
+            return;
+        }
+        uint32_t msb = bitScanReverse(size);
+        fl = msb - SL_BITS + 1;
+        sl = static_cast<uint32_t>(size >> (msb - SL_BITS)) & (SL_COUNT - 1);
+    }
+
+    uint32_t newNode() {
+        if (!unusedNodes.empty()) {
+            uint32_t index = unusedNodes.back();
+            unusedNodes.pop_back();
+            nodes[index] = Node{};
+            return index;
+        }
+        nodes.emplace_back();
+        return static_cast<uint32_t>(nodes.size() - 1);
+    }
+
+    void insertFree(uint32_t index) {
+        Node& node = nodes[index];
+        uint32_t fl, sl;
+        mapping(node.size, fl, sl);
+        node.free = true;
+        node.prevFree = NONE;
+        node.nextFree = heads[fl][sl];
+        if (node.nextFree != NONE) nodes[node.nextFree].prevFree = index;
+        heads[fl][sl] = index;
+        flBitmap |= 1ull << fl;
+        slBitmap[fl] |= 1u << sl;
+    }
+
+    void removeFree(uint32_t index) {
+        Node& node = nodes[index];
+        uint32_t fl, sl;
+        mapping(node.size, fl, sl);
+        if (node.prevFree != NONE) nodes[node.prevFree].nextFree = node.nextFree;
+        else heads[fl][sl] = node.nextFree;
+        if (node.nextFree != NONE) nodes[node.nextFree].prevFree = node.prevFree;
+        if (heads[fl][sl] == NONE) {
+            slBitmap[fl] &= ~(1u << sl);
+            if (!slBitmap[fl]) flBitmap &= ~(1ull << fl);
+        }
+        node.free = false;
+        node.prevFree = node.nextFree = NONE;
+    }
+
+    // first block of a cell whose every entry is at least size
+    uint32_t findFree(VkDeviceSize size) const {
+        if (size >= SL_COUNT) size += (VkDeviceSize(1) << (bitScanReverse(size) - SL_BITS)) - 1;
+        uint32_t fl, sl;
+        mapping(size, fl, sl);
+        if (fl >= FL_COUNT) return NONE;
+
+        uint32_t slMap = slBitmap[fl] & (~0u << sl);
+        if (!slMap) {
+            uint64_t flMap = fl + 1 < 64 ? flBitmap & (~0ull << (fl + 1)) : 0;
+            if (!flMap) return NONE;
+            fl = bitScanForward(flMap);
+            slMap = slBitmap[fl];
+        }
+        return heads[fl][bitScanForward(slMap)];
+    }
+
+    // the cell size itself falls into is skipped by findFree, walk it for a block that still fits once aligned
+    uint32_t findInCell(VkDeviceSize size, VkDeviceSize alignment) const {
+        uint32_t fl, sl;
+        mapping(size, fl, sl);
+        if (fl >= FL_COUNT) return NONE;
+        for (uint32_t index = heads[fl][sl]; index != NONE; index = nodes[index].nextFree) {
+            const Node& node = nodes[index];
+            if (align_up(node.offset, alignment) - node.offset + size <= node.size) return index;
+        }
+        return NONE;
+    }
+
+    // splits [node.offset + size, end) off into a new free block
+    void splitTail(uint32_t index, VkDeviceSize size) {
+        uint32_t tail = newNode();
+        Node& node = nodes[index];
+        Node& rest = nodes[tail];
+        rest.offset = node.offset + size;
+        rest.size = node.size - size;
+        rest.prevPhysical = index;
+        rest.nextPhysical = node.nextPhysical;
+        if (rest.nextPhysical != NONE) nodes[rest.nextPhysical].prevPhysical = tail;
+        node.nextPhysical = tail;
+        node.size = size;
+        insertFree(tail);
+    }
+
+    // absorbs the physical successor of index, neither may be in a free list
+    void absorbNext(uint32_t index) {
+        uint32_t next = nodes[index].nextPhysical;
+        nodes[index].size += nodes[next].size;
+        nodes[index].nextPhysical = nodes[next].nextPhysical;
+        if (nodes[index].nextPhysical != NONE) nodes[nodes[index].nextPhysical].prevPhysical = index;
+        unusedNodes.push_back(next);
+    }
+
+public:
+    explicit TlsfAllocator(VkDeviceSize size) : capacity(size) {
+        for (auto& row : heads)
+            for (uint32_t& head : row) head = NONE;
+        uint32_t root = newNode();
+        nodes[root].size = size;
+        insertFree(root);
+    }
+
+    // NONE when nothing fits, otherwise a handle for free() and the aligned offset
+    uint32_t allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset) {
+        size = std::max<VkDeviceSize>(size, 1);
+        alignment = std::max<VkDeviceSize>(alignment, 1);
+
+        uint32_t index = findFree(size + alignment - 1);
+        if (index == NONE) index = findInCell(size, alignment);
+        if (index == NONE) return NONE;
+        removeFree(index);
+
+        VkDeviceSize padding = align_up(nodes[index].offset, alignment) - nodes[index].offset;
+        if (padding) {
+            // the front padding stays a free block of its own, the aligned rest becomes the allocation
+            splitTail(index, padding);
+            uint32_t front = index;
+            index = nodes[front].nextPhysical;
+            removeFree(index);
+            insertFree(front);
+        }
+        if (nodes[index].size > size) splitTail(index, size);
+
+        used += nodes[index].size;
+        liveAllocations++;
+        offset = nodes[index].offset;
+        return index;
+    }
+
+    void free(uint32_t index) {
+        used -= nodes[index].size;
+        liveAllocations--;
+
+        uint32_t next = nodes[index].nextPhysical;
+        if (next != NONE && nodes[next].free) {
+            removeFree(next);
+            absorbNext(index);
+        }
+        uint32_t prev = nodes[index].prevPhysical;
+        if (prev != NONE && nodes[prev].free) {
+            removeFree(prev);
+            absorbNext(prev);
+            index = prev;
+        }
+        insertFree(index);
+    }
+
+    VkDeviceSize size(uint32_t index) const { return nodes[index].size; }
+    VkDeviceSize capacityBytes() const { return capacity; }
+    VkDeviceSize usedBytes() const { return used; }
+    uint32_t allocationCount() const { return liveAllocations; }
+    bool empty() const { return liveAllocations == 0; }
 };
 
-class VulkanMemoryManagement {
-protected:
-    VkDevice * device;
-    VkPhysicalDevice *  physicalDevice;
-    VkDeviceMemory memoryPool;
-    VkDeviceSize poolSize;
-    VkDeviceSize currentOffset = 0;  // Linear offset
-    std::unordered_map<VkBuffer, AllocationInfo> allocations;
+/*
+Bump allocator over one buffer split into a slice per frame in flight, no Vulkan calls.
+begin(frame) rewinds that frame's slice, the caller must have waited on the fence of the submission that last used it.
+Offsets are relative to the start of the buffer, so they can be passed straight as dynamic offsets.
+*/
+class FrameRingAllocator {
+    VkDeviceSize frameSize = 0;
+    VkDeviceSize alignment = 1;
+    uint32_t frameCount = 0;
+    uint32_t frame = 0;
+    VkDeviceSize head = 0;
+    VkDeviceSize highWater = 0;
 
 public:
-    VulkanMemoryManagement() = default;
-    VulkanMemoryManagement(VkPhysicalDevice& physicalDevice, VkDevice &device, VkDeviceSize size, 
-        VkMemoryPropertyFlags properties) : device(&device), poolSize(size), physicalDevice(&physicalDevice){
-        // allocate large mem block
+    FrameRingAllocator() = default;
+
+    // frameBytes is rounded up to alignment so every slice starts aligned
+    FrameRingAllocator(uint32_t frames, VkDeviceSize frameBytes, VkDeviceSize offsetAlignment)
+        : alignment(std::max<VkDeviceSize>(offsetAlignment, 1)), frameCount(frames) {
+        frameSize = align_up(frameBytes, alignment);
+    }
+
+    VkDeviceSize totalSize() const { return frameSize * frameCount; }
+    VkDeviceSize frameBytes() const { return frameSize; }
+    VkDeviceSize peakBytes() const { return highWater; }
+
+    void begin(uint32_t frameIndex) {
+        frame = frameIndex % frameCount;
+        head = 0;
+    }
+
+    VkDeviceSize allocate(VkDeviceSize size) {
+        VkDeviceSize offset = align_up(head, alignment);
+        if (offset + size > frameSize) throw std::runtime_error("frame ring slice overflow!");
+        head = offset + size;
+        highWater = std::max(highWater, head);
+        return frame * frameSize + offset;
+    }
+};
+
+/*
+Ring over a staging buffer, no Vulkan calls. head and tail are running byte counts, so an empty and a full ring
+never look alike. Regions are handed out in order and given back in order by release(mark), where mark is the
+head() seen when the batch that used them was submitted. A region never wraps, the unused end is skipped instead.
+*/
+class StagingRing {
+    VkDeviceSize capacity = 0;
+    uint64_t head_ = 0;
+    uint64_t tail = 0;
+
+public:
+    static constexpr VkDeviceSize NONE = ~VkDeviceSize(0);
+
+    StagingRing() = default;
+    explicit StagingRing(VkDeviceSize size) : capacity(size) {}
+
+    VkDeviceSize size() const { return capacity; }
+    uint64_t head() const { return head_; }
+    VkDeviceSize usedBytes() const { return head_ - tail; }
+
+    // offset inside the buffer, NONE until enough older regions are released
+    VkDeviceSize allocate(VkDeviceSize size, VkDeviceSize alignment) {
+        if (size > capacity) return NONE;
+        uint64_t start = align_up<uint64_t>(head_, std::max<VkDeviceSize>(alignment, 1));
+        if (start % capacity + size > capacity) start = align_up<uint64_t>(start, capacity);
+        if (start + size - tail > capacity) return NONE;
+        head_ = start + size;
+        return start % capacity;
+    }
+
+    void release(uint64_t mark) { tail = std::max(tail, mark); }
+};
+
+// default VkDeviceMemory block per pool, requests above half of it get a block of their own
+constexpr VkDeviceSize MMM_DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+
+// what a piece of device memory is used for, every allocation is charged to exactly one
+enum class MemoryCategory : uint32_t {
+    Vertex, Index, BLAS, TLAS, Scratch, SBT, Texture, Uniform, Staging, Other, Count
+};
+
+inline const char* memoryCategoryName(MemoryCategory category) {
+    static const char* names[] = { "vertex", "index", "blas", "tlas", "scratch", "sbt", "texture", "uniform", "staging", "other" };
+    return names[static_cast<uint32_t>(category)];
+}
+
+struct MemoryCategoryStats {
+    uint64_t liveAllocations = 0;
+    uint64_t totalAllocations = 0;
+    VkDeviceSize bytes = 0;       // live, as charged by the pools or the dedicated allocation
+    VkDeviceSize peakBytes = 0;
+};
+
+// sub-allocation handed out by the pools, memory + offset is what vkBind*Memory takes
+struct MemoryAllocation {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    void* mapped = nullptr;     // host visible blocks stay mapped, already offset to this allocation
+    uint32_t pool = UINT32_MAX; // owner inside VulkanMemoryManagementModule, UINT32_MAX = not allocated
+    uint32_t block = 0;
+    uint32_t node = 0;
+    MemoryCategory category = MemoryCategory::Other;
+    VkDeviceSize alignment = 1;
+    // what the buffer bound here was created with, a defragmentation move recreates it from these
+    VkBufferUsageFlags usage = 0;
+    VkDeviceSize bufferSize = 0;
+};
+
+// totals since init, a pool only calls vkAllocateMemory when it grows by a block
+struct MemoryPoolStats {
+    uint64_t allocations = 0;
+    uint64_t frees = 0;
+    uint64_t deviceAllocations = 0;  // vkAllocateMemory calls
+    uint64_t blocks = 0;             // live VkDeviceMemory blocks
+    VkDeviceSize reservedBytes = 0;
+    VkDeviceSize usedBytes = 0;
+    double allocateMs = 0.0;         // inside allocate(), vkAllocateMemory included
+    uint64_t moves = 0;              // planMove targets handed out
+    VkDeviceSize movedBytes = 0;
+};
+
+/*
+All blocks of one memory type (and one allocate flag set). Blocks are added on demand and every block runs its
+own TlsfAllocator, a block that becomes empty is given back to the driver unless it is the last one.
+*/
+class VulkanMemoryManagement {
+protected:
+    struct Block {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        std::unique_ptr<TlsfAllocator> allocator;
+        void* mapped = nullptr;
+    };
+
+    VkDevice* device;
+    uint32_t memoryType;
+    bool hostVisible;
+    bool deviceAddress;
+    VkDeviceSize blockSize;
+    std::vector<Block> blocks;  // empty slots (memory == VK_NULL_HANDLE) are reused
+    MemoryPoolStats* stats;
+
+    bool addBlock(VkDeviceSize size, uint32_t& blockIndex) {
         VkMemoryAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
         allocInfo.allocationSize = size;
-        allocInfo.memoryTypeIndex = findMemoryTypePool( physicalDevice , properties);
+        allocInfo.memoryTypeIndex = memoryType;
 
-        vkAllocateMemory(device, &allocInfo, nullptr, &memoryPool);
-    }
+        VkMemoryAllocateFlagsInfo allocFlagsInfo{};
+        if (deviceAddress) {
+            allocFlagsInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO;
+            allocFlagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT;
+            allocInfo.pNext = &allocFlagsInfo;
+        }
 
-    // Allocate memory for a buffer
-    VkDeviceSize allocate(VkBuffer buffer, VkDeviceSize size) {
-        if (currentOffset + size > poolSize) {
-            return VK_WHOLE_SIZE; // Out of memory
+        Block block;
+        if (vkAllocateMemory(*device, &allocInfo, nullptr, &block.memory) != VK_SUCCESS) return false;
+        if (hostVisible && vkMapMemory(*device, block.memory, 0, VK_WHOLE_SIZE, 0, &block.mapped) != VK_SUCCESS) {
+            vkFreeMemory(*device, block.memory, nullptr);
+            return false;
         }
+        block.allocator = std::make_unique<TlsfAllocator>(size);
 
-        VkDeviceSize allocatedOffset = currentOffset;
-        currentOffset += size; // Move offset forward
+        stats->deviceAllocations++;
+        stats->blocks++;
+        stats->reservedBytes += size;
 
-        // Store allocation info
-        allocations[buffer] = { allocatedOffset, size };
+        for (blockIndex = 0; blockIndex < blocks.size(); ++blockIndex)
+            if (blocks[blockIndex].memory == VK_NULL_HANDLE) break;
+        if (blockIndex == blocks.size()) blocks.emplace_back();
+        blocks[blockIndex] = std::move(block);
+        return true;
+    }
 
-        // Bind buffer to allocated offset
-        vkBindBufferMemory(device, buffer, memoryPool, allocatedOffset);
+    void releaseBlock(uint32_t blockIndex) {
+        Block& block = blocks[blockIndex];
+        stats->blocks--;
+        stats->reservedBytes -= block.allocator->capacityBytes();
+        if (block.mapped) vkUnmapMemory(*device, block.memory);
+        vkFreeMemory(*device, block.memory, nullptr);
+        block = Block{};
+    }
 
-        return allocatedOffset;
+public:
+    VulkanMemoryManagement(VkDevice& device, uint32_t memoryType, VkMemoryPropertyFlags typeFlags, bool deviceAddress,
+        VkDeviceSize blockSize, MemoryPoolStats* stats)
+        : device(&device), memoryType(memoryType), hostVisible((typeFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0),
+        deviceAddress(deviceAddress), blockSize(blockSize), stats(stats) {}
+
+    uint32_t type() const { return memoryType; }
+    VkDeviceSize reservedBytes() const {
+        VkDeviceSize total = 0;
+        for (const Block& block : blocks) if (block.memory != VK_NULL_HANDLE) total += block.allocator->capacityBytes();
+        return total;
     }
 
-    // Free memory (logical removal only)
-    void free(VkBuffer buffer) {
-        allocations.erase(buffer);
-        // No merging, just track logical deallocations
+    VulkanMemoryManagement(const VulkanMemoryManagement&) = delete;
+    VulkanMemoryManagement& operator=(const VulkanMemoryManagement&) = delete;
+
+    // false when no block fits and the driver refuses a new one
+    bool allocate(VkDeviceSize size, VkDeviceSize alignment, MemoryAllocation& allocation) {
+        for (uint32_t b = 0; b < blocks.size(); ++b) {
+            if (blocks[b].memory == VK_NULL_HANDLE) continue;
+            VkDeviceSize offset;
+            uint32_t node = blocks[b].allocator->allocate(size, alignment, offset);
+            if (node == TlsfAllocator::NONE) continue;
+            fill(b, node, offset, allocation);
+            return true;
+        }
+
+        // big requests get an exact block instead of wasting most of a shared one, with room to align inside it
+        VkDeviceSize newBlockSize = size > blockSize / 2 ? size + std::max<VkDeviceSize>(alignment, 1) - 1 : blockSize;
+        uint32_t b;
+        if (!addBlock(newBlockSize, b)) return false;
+        VkDeviceSize offset;
+        uint32_t node = blocks[b].allocator->allocate(size, alignment, offset);
+        if (node == TlsfAllocator::NONE) {
+            // a block nothing fits into only holds driver memory
+            releaseBlock(b);
+            return false;
+        }
+        fill(b, node, offset, allocation);
+        return true;
     }
 
-    // Retrieve the offset for a given buffer
-    VkDeviceSize getOffset(VkBuffer buffer) {
-        return allocations.count(buffer) ? allocations[buffer].offset : VK_WHOLE_SIZE;
+    // only device local pools are defragmented, host visible allocations have their mapped pointers held elsewhere
+    bool movable() const { return !hostVisible; }
+
+    // live block holding the fewest bytes, NONE while there is no other block it could be emptied into
+    uint32_t emptiestBlock() const {
+        uint32_t emptiest = TlsfAllocator::NONE;
+        uint32_t liveBlocks = 0;
+        for (uint32_t b = 0; b < blocks.size(); ++b) {
+            if (blocks[b].memory == VK_NULL_HANDLE) continue;
+            liveBlocks++;
+            if (emptiest == TlsfAllocator::NONE || blocks[b].allocator->usedBytes() < blocks[emptiest].allocator->usedBytes())
+                emptiest = b;
+        }
+        return liveBlocks > 1 ? emptiest : TlsfAllocator::NONE;
     }
 
-    ~VulkanMemoryManagement() {
-        vkFreeMemory(device, memoryPool, nullptr);
+    /*
+    New place for src that lets the pool shrink, never adds a block.
+        src in the emptiest block  -> any other block, once it is drained free() releases it
+        otherwise                  -> a lower offset in its own block, holes fill from the front
+    The old allocation stays live, the caller frees it once the copy has landed.
+    */
+    bool planMove(const MemoryAllocation& src, MemoryAllocation& dst) {
+        VkDeviceSize offset;
+        if (src.block == emptiestBlock()) {
+            for (uint32_t b = 0; b < blocks.size(); ++b) {
+                if (b == src.block || blocks[b].memory == VK_NULL_HANDLE) continue;
+                uint32_t node = blocks[b].allocator->allocate(src.size, src.alignment, offset);
+                if (node == TlsfAllocator::NONE) continue;
+                fill(b, node, offset, dst);
+                return true;
+            }
+        }
+
+        TlsfAllocator& allocator = *blocks[src.block].allocator;
+        uint32_t node = allocator.allocate(src.size, src.alignment, offset);
+        if (node == TlsfAllocator::NONE) return false;
+        if (offset >= src.offset) {
+            allocator.free(node);
+            return false;
+        }
+        fill(src.block, node, offset, dst);
+        return true;
     }
-};
 
-class VulkanMemoryManagementGPU : public VulkanMemoryManagement {
-private :
+    void free(const MemoryAllocation& allocation) {
+        Block& block = blocks[allocation.block];
+        stats->usedBytes -= block.allocator->size(allocation.node);
+        block.allocator->free(allocation.node);
 
-public :
-    VulkanMemoryManagementGPU() = default;
-    VulkanMemoryManagementGPU(VkPhysicalDevice& physicalDevice, VkDevice& device, VkDeviceSize size, VkMemoryPropertyFlags properties) {
-        VulkanMemoryManagement::VulkanMemoryManagement( physicalDevice,device, size, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        if (!block.allocator->empty()) return;
+        size_t liveBlocks = 0;
+        for (const Block& other : blocks) if (other.memory != VK_NULL_HANDLE) liveBlocks++;
+        if (liveBlocks > 1) releaseBlock(allocation.block);
+    }
+
+    ~VulkanMemoryManagement() {
+        for (uint32_t b = 0; b < blocks.size(); ++b)
+            if (blocks[b].memory != VK_NULL_HANDLE) releaseBlock(b);
     }
 
+private:
+    void fill(uint32_t blockIndex, uint32_t node, VkDeviceSize offset, MemoryAllocation& allocation) {
+        const Block& block = blocks[blockIndex];
+        allocation.memory = block.memory;
+        allocation.offset = offset;
+        allocation.size = block.allocator->size(node);
+        allocation.mapped = block.mapped ? static_cast<uint8_t*>(block.mapped) + offset : nullptr;
+        allocation.block = blockIndex;
+        allocation.node = node;
+        stats->usedBytes += allocation.size;
+    }
 };
 
+/*
+Front door of the memory module, one VulkanMemoryManagement per (memory type, device address flag) created on
+first use. The memory type is the first one allowed by VkMemoryRequirements::memoryTypeBits that has all the
+requested properties, the next matching type is tried when that heap is exhausted.
+Only linear resources (buffers) are placed here, so bufferImageGranularity never applies inside a block.
+Dedicated allocations made elsewhere (images) are only registered, so the per category totals cover all device memory.
+*/
 class VulkanMemoryManagementModule {
 
 private :
+    VkDevice* device = nullptr;
+    VkPhysicalDeviceMemoryProperties memoryProperties{};
+    VkDeviceSize blockSize = MMM_DEFAULT_BLOCK_SIZE;
+    std::array<std::unique_ptr<VulkanMemoryManagement>, VK_MAX_MEMORY_TYPES * 2> pools;
+    MemoryPoolStats stats;
+    std::array<MemoryCategoryStats, static_cast<size_t>(MemoryCategory::Count)> categories;
+    struct DedicatedAllocation {
+        VkDeviceSize size;
+        uint32_t memoryType;
+        MemoryCategory category;
+    };
+    std::unordered_map<VkDeviceMemory, DedicatedAllocation> dedicated;
+    std::mutex mutex;
+
+    void charge(MemoryCategory category, VkDeviceSize size) {
+        MemoryCategoryStats& entry = categories[static_cast<size_t>(category)];
+        entry.liveAllocations++;
+        entry.totalAllocations++;
+        entry.bytes += size;
+        entry.peakBytes = std::max(entry.peakBytes, entry.bytes);
+    }
+
+    void refund(MemoryCategory category, VkDeviceSize size) {
+        MemoryCategoryStats& entry = categories[static_cast<size_t>(category)];
+        entry.liveAllocations--;
+        entry.bytes -= size;
+    }
 
 public :
     VulkanMemoryManagementModule() = default;
 
+    void init(VkPhysicalDevice& physicalDevice, VkDevice& logicalDevice, VkDeviceSize poolBlockSize = MMM_DEFAULT_BLOCK_SIZE) {
+        device = &logicalDevice;
+        blockSize = poolBlockSize;
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+    }
+
+    MemoryAllocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool deviceAddress,
+        MemoryCategory category = MemoryCategory::Other) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto startTime = std::chrono::high_resolution_clock::now();
+
+        MemoryAllocation allocation;
+        for (uint32_t type = 0; type < memoryProperties.memoryTypeCount; ++type) {
+            if (!(requirements.memoryTypeBits & (1u << type))) continue;
+            const VkMemoryPropertyFlags typeFlags = memoryProperties.memoryTypes[type].propertyFlags;
+            if ((typeFlags & properties) != properties) continue;
+
+            const uint32_t poolIndex = type * 2 + (deviceAddress ? 1 : 0);
+            if (!pools[poolIndex])
+                pools[poolIndex] = std::make_unique<VulkanMemoryManagement>(*device, type, typeFlags, deviceAddress, blockSize, &stats);
+            if (pools[poolIndex]->allocate(requirements.size, requirements.alignment, allocation)) {
+                allocation.pool = poolIndex;
+                allocation.alignment = requirements.alignment;
+                break;
+            }
+        }
+
+        stats.allocateMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+        if (allocation.pool == UINT32_MAX) throw std::runtime_error("failed to allocate buffer memory!");
+        stats.allocations++;
+        allocation.category = category;
+        charge(category, allocation.size);
+        return allocation;
+    }
+
+    void free(MemoryAllocation& allocation) {
+        if (allocation.pool == UINT32_MAX) return;
+        std::lock_guard<std::mutex> lock(mutex);
+        refund(allocation.category, allocation.size);
+        pools[allocation.pool]->free(allocation);
+        stats.frees++;
+        allocation = MemoryAllocation{};
+    }
+
+    MemoryPoolStats getStats() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats;
+    }
 
+    // defragmentation target for a live allocation, see VulkanMemoryManagement::planMove
+    // dst keeps the category, alignment and buffer description of src, both are live until src is freed
+    bool planMove(const MemoryAllocation& src, MemoryAllocation& dst) {
+        if (src.pool == UINT32_MAX) return false;
+        std::lock_guard<std::mutex> lock(mutex);
+        VulkanMemoryManagement& pool = *pools[src.pool];
+        if (!pool.movable()) return false;
+
+        dst = src;
+        if (!pool.planMove(src, dst)) return false;
+        stats.allocations++;
+        stats.moves++;
+        stats.movedBytes += dst.size;
+        charge(dst.category, dst.size);
+        return true;
+    }
 
+    // vkAllocateMemory made outside the pools, charged until untrackDedicated
+    void trackDedicated(VkDeviceMemory memory, VkDeviceSize size, uint32_t memoryType, MemoryCategory category) {
+        std::lock_guard<std::mutex> lock(mutex);
+        dedicated[memory] = { size, memoryType, category };
+        charge(category, size);
+    }
 
+    void untrackDedicated(VkDeviceMemory memory) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = dedicated.find(memory);
+        if (it == dedicated.end()) return;
+        refund(it->second.category, it->second.size);
+        dedicated.erase(it);
+    }
 
+    std::array<MemoryCategoryStats, static_cast<size_t>(MemoryCategory::Count)> getCategoryStats() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return categories;
+    }
+
+    // bytes this module holds from each heap, pool blocks plus dedicated allocations, memoryHeapCount entries are used
+    std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> getHeapUsage() {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> heaps{};
+        for (const auto& pool : pools)
+            if (pool) heaps[memoryProperties.memoryTypes[pool->type()].heapIndex] += pool->reservedBytes();
+        for (const auto& entry : dedicated)
+            heaps[memoryProperties.memoryTypes[entry.second.memoryType].heapIndex] += entry.second.size;
+        return heaps;
+    }
+
+    const VkPhysicalDeviceMemoryProperties& getMemoryProperties() const { return memoryProperties; }
+
+    // every allocation must have been freed or be abandoned with the device
+    void destroy() {
+        for (auto& pool : pools) pool.reset();
+    }
+
+    ~VulkanMemoryManagementModule() { destroy(); }
 };
 
 
@@ -131,25 +719,21 @@ Sparse Binding Memory	                  |VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT + V
 
 /*
 
-// Create memory pool (256MB)
-VulkanMemoryPool memoryPool(device, 256 * 1024 * 1024);
-
-// Create a buffer
-VkBufferCreateInfo bufferInfo{};
-bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-bufferInfo.size = 64 * 1024; // 64KB buffer
-bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
-bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+VulkanMemoryManagementModule memory;
+memory.init(physicalDevice, device);
 
 VkBuffer myBuffer;
 vkCreateBuffer(device, &bufferInfo, nullptr, &myBuffer);
 
-// Allocate from pool
-VkDeviceSize offset = memoryPool.allocate(myBuffer, bufferInfo.size);
+VkMemoryRequirements requirements;
+vkGetBufferMemoryRequirements(device, myBuffer, &requirements);
 
-// Retrieve the offset of the buffer later
-VkDeviceSize storedOffset = memoryPool.getOffset(myBuffer);
+// sub-allocated from the pool of the first matching memory type, aligned for this buffer
+MemoryAllocation allocation = memory.allocate(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false);
+vkBindBufferMemory(device, myBuffer, allocation.memory, allocation.offset);
 
+vkDestroyBuffer(device, myBuffer, nullptr);
+memory.free(allocation);   // merged back with free neighbours, reusable right away
 
 */
 
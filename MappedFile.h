@@ -0,0 +1,105 @@
+#ifndef __MAPPED_FILE_H__
+#define __MAPPED_FILE_H__
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// read only view of a whole file, the OS pages it in on demand so nothing is parsed or copied up front
+class MappedFile {
+private:
+    const uint8_t* mappedData = nullptr;
+    size_t mappedSize = 0;
+#ifdef _WIN32
+    HANDLE fileHandle = INVALID_HANDLE_VALUE;
+    HANDLE mappingHandle = NULL;
+#endif
+
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::string& path) { open(path); }
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path) {
+        close();
+#ifdef _WIN32
+        fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (fileHandle == INVALID_HANDLE_VALUE) return false;
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0) { close(); return false; }
+
+        mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mappingHandle == NULL) { close(); return false; }
+
+        mappedData = static_cast<const uint8_t*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+        if (!mappedData) { close(); return false; }
+        mappedSize = static_cast<size_t>(fileSize.QuadPart);
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+
+        struct stat fileStat;
+        if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) { ::close(fd); return false; }
+
+        void* view = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        // the mapping keeps its own reference to the file
+        ::close(fd);
+        if (view == MAP_FAILED) return false;
+
+        madvise(view, static_cast<size_t>(fileStat.st_size), MADV_SEQUENTIAL);
+        mappedData = static_cast<const uint8_t*>(view);
+        mappedSize = static_cast<size_t>(fileStat.st_size);
+#endif
+        return true;
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (mappedData) UnmapViewOfFile(mappedData);
+        if (mappingHandle != NULL) CloseHandle(mappingHandle);
+        if (fileHandle != INVALID_HANDLE_VALUE) CloseHandle(fileHandle);
+        mappingHandle = NULL;
+        fileHandle = INVALID_HANDLE_VALUE;
+#else
+        if (mappedData) munmap(const_cast<uint8_t*>(mappedData), mappedSize);
+#endif
+        mappedData = nullptr;
+        mappedSize = 0;
+    }
+
+    bool isOpen() const { return mappedData != nullptr; }
+    const uint8_t* data() const { return mappedData; }
+    size_t size() const { return mappedSize; }
+};
+
+// FNV-1a over 8 byte words, only used to key cached data to its source, not for security
+uint64_t hashBytes(const uint8_t* data, size_t size, uint64_t seed = 0xcbf29ce484222325ull) {
+    const uint64_t prime = 0x100000001b3ull;
+    uint64_t hash = seed;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        hash = (hash ^ word) * prime;
+    }
+    for (; i < size; ++i) hash = (hash ^ data[i]) * prime;
+    return hash ^ (hash >> 32);
+}
+
+#endif
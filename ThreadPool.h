@@ -0,0 +1,115 @@
+#ifndef __THREAD_POOL_H__
+#define __THREAD_POOL_H__
+
+// fixed size worker pool used for cpu side asset work (mesh conversion, decoding, host builds)
+class ThreadPool {
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex queueMutex;
+    std::condition_variable condition;
+    bool stop = false;
+
+public:
+    explicit ThreadPool(size_t threadCount = std::max(1u, std::thread::hardware_concurrency())) {
+        for (size_t i = 0; i < threadCount; ++i) {
+            workers.emplace_back([this] {
+                for (;;) {
+                    std::function<void()> task;
+                    {
+                        std::unique_lock<std::mutex> lock(queueMutex);
+                        condition.wait(lock, [this] { return stop || !tasks.empty(); });
+                        if (stop && tasks.empty()) return;
+                        task = std::move(tasks.front());
+                        tasks.pop();
+                    }
+                    task();
+                }
+            });
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool() {
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            stop = true;
+        }
+        condition.notify_all();
+        for (std::thread& worker : workers) worker.join();
+    }
+
+    size_t size() const { return workers.size(); }
+
+    // queue a job, the future carries the result (or the exception) back to the caller
+    template <typename F>
+    auto enqueue(F&& f) -> std::future<decltype(f())> {
+        using ReturnType = decltype(f());
+        // packaged_task is move only, std::function needs a copyable target
+        auto task = std::make_shared<std::packaged_task<ReturnType()>>(std::forward<F>(f));
+        std::future<ReturnType> result = task->get_future();
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            if (stop) throw std::runtime_error("enqueue on stopped ThreadPool!");
+            tasks.emplace([task]() { (*task)(); });
+        }
+        condition.notify_one();
+        return result;
+    }
+
+    // run fn(i) for i in [0, count), the calling thread takes indices as well and only waits on
+    // work that is actually in flight, so nested calls from inside a worker cannot deadlock
+    void parallelFor(size_t count, const std::function<void(size_t)>& fn) {
+        if (count == 0) return;
+        if (count == 1 || workers.empty()) {
+            for (size_t i = 0; i < count; ++i) fn(i);
+            return;
+        }
+
+        struct ForState {
+            std::atomic<size_t> next{ 0 };
+            size_t done = 0;
+            size_t count = 0;
+            std::function<void(size_t)> fn;
+            std::exception_ptr error;
+            std::mutex mutex;
+            std::condition_variable finished;
+        };
+        // helpers may start after the caller returned, so they only hold the shared state
+        auto state = std::make_shared<ForState>();
+        state->count = count;
+        state->fn = fn;
+
+        auto drain = [state]() {
+            size_t completed = 0;
+            std::exception_ptr error;
+            for (size_t i = state->next.fetch_add(1); i < state->count; i = state->next.fetch_add(1)) {
+                try { state->fn(i); }
+                catch (...) { if (!error) error = std::current_exception(); }
+                ++completed;
+            }
+            if (completed == 0) return;
+            std::unique_lock<std::mutex> lock(state->mutex);
+            if (error && !state->error) state->error = error;
+            state->done += completed;
+            if (state->done == state->count) state->finished.notify_all();
+        };
+
+        size_t helpers = std::min(workers.size(), count - 1);
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            for (size_t i = 0; i < helpers; ++i) tasks.emplace(drain);
+        }
+        condition.notify_all();
+
+        drain();
+
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->finished.wait(lock, [&] { return state->done == state->count; });
+        if (state->error) std::rethrow_exception(state->error);
+    }
+};
+
+#endif
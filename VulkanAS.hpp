@@ -30,43 +30,448 @@ Would you like an example setup for handling materials and textures in Vulkan RT
  
 	*/
 
-	void MainVulkApplication::createBLAS() {
-
-		VkAccelerationStructureGeometryKHR geometry = {};
-		geometry.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
-		geometry.geometryType = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
-		geometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR; // Skip anyhit shader for performance
-		geometry.geometry.triangles.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR;
-		geometry.geometry.triangles.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT;
-		geometry.geometry.triangles.vertexData.deviceAddress = GetBufferDeviceAddress(vertexBuffer);
-		geometry.geometry.triangles.vertexStride = sizeof(Vertex);
-		geometry.geometry.triangles.indexType = VK_INDEX_TYPE_UINT32;
-		geometry.geometry.triangles.indexData.deviceAddress = GetBufferDeviceAddress(indexBuffer);
-
-		VkAccelerationStructureBuildGeometryInfoKHR buildInfo = {};
+	/*
+	One BLAS per LOD level of every SceneObject (submesh), each with a single triangle geometry.
+	All of them share the vertex / index buffers, primitiveOffset selects the level's index range. The instance
+	picks the level, so the hit shaders find the submesh through gl_InstanceCustomIndexEXT -> MeshInfo (material, first index).
+	prepareBLAS sizes and creates the structure and fills build, buildBLASBatches records it together with the others.
+	The flags come from policy, Auto takes the object's own. A level that already has its structure keeps it, so
+	updateObjectBLAS can rebuild or refit into the same handle.
+	host prepares it for buildBLASHost instead : cpu geometry pointers, host build sizes and a host visible structure,
+	createBLAS compacts or clones it into device local memory afterwards.
+	*/
+	void MainVulkApplication::prepareBLAS(const SceneObject& object, LodLevel& level, BlasBuild& build, AsBuildPolicy policy, bool host) {
+
+		// packed positions when they were split out (always for compact scenes), the attribute buffer is hit shading only
+		VkDeviceAddress vertexAddress;
+		VkDeviceSize vertexStride;
+		if (positionBuffer != VK_NULL_HANDLE) {
+			vertexAddress = GetBufferDeviceAddress(positionBuffer);
+			vertexStride = sizeof(glm::vec3);
+		}
+		else {
+			vertexAddress = GetBufferDeviceAddress(vertexBuffer) + offsetof(Vertex, pos);
+			vertexStride = sizeof(Vertex);
+		}
+
+		const MeshRange& range = object.range;
+
+		VkAccelerationStructureGeometryKHR& triangleGeometry = build.geometry;
+		triangleGeometry = {};
+		triangleGeometry.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
+		triangleGeometry.geometryType = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
+		triangleGeometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR; // Skip anyhit shader for performance
+		triangleGeometry.geometry.triangles.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR;
+		triangleGeometry.geometry.triangles.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT;
+		triangleGeometry.geometry.triangles.vertexData.deviceAddress = vertexAddress;
+		triangleGeometry.geometry.triangles.vertexStride = vertexStride;
+		// indices are global, every level only ever touches the submesh's vertex range
+		triangleGeometry.geometry.triangles.maxVertex = range.firstVertex + std::max(range.vertexCount, 1u) - 1;
+		triangleGeometry.geometry.triangles.indexType = VK_INDEX_TYPE_UINT32;
+		triangleGeometry.geometry.triangles.indexData.deviceAddress = GetBufferDeviceAddress(indexBuffer);
+		if (host) {
+			// the imported arrays, positions interleaved whatever layout the gpu buffers use
+			triangleGeometry.geometry.triangles.vertexData.hostAddress = reinterpret_cast<const uint8_t*>(geometry.vertices) + offsetof(Vertex, pos);
+			triangleGeometry.geometry.triangles.vertexStride = sizeof(Vertex);
+			triangleGeometry.geometry.triangles.indexData.hostAddress = geometry.indices;
+		}
+
+		uint32_t primitiveCount = level.indexCount / 3;
+		build.rangeInfo = {};
+		build.rangeInfo.primitiveCount = primitiveCount;
+		build.rangeInfo.primitiveOffset = level.firstIndex * sizeof(uint32_t);
+		build.rangeInfo.firstVertex = 0;
+
+		VkAccelerationStructureBuildGeometryInfoKHR& buildInfo = build.buildInfo;
+		buildInfo = {};
 		buildInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
 		buildInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
-		buildInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR; // Optimize for ray traversal
+		buildInfo.flags = asBuildFlags(policy == AsBuildPolicy::Auto ? object.buildPolicy : policy);
+		buildInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
 		buildInfo.geometryCount = 1;
-		buildInfo.pGeometries = &geometry;
+		buildInfo.pGeometries = &triangleGeometry;
 
 		VkAccelerationStructureBuildSizesInfoKHR sizeInfo = {};
 		sizeInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
-		vkGetAccelerationStructureBuildSizesKHR(device, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &buildInfo, &primitiveCount, &sizeInfo);
+		vkGetAccelerationStructureBuildSizesKHR(device, host ? VK_ACCELERATION_STRUCTURE_BUILD_TYPE_HOST_KHR : VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR,
+			&buildInfo, &primitiveCount, &sizeInfo);
 
-		VkAccelerationStructureCreateInfoKHR asCreateInfo = {};
-		asCreateInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR;
-		asCreateInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
-		asCreateInfo.size = sizeInfo.accelerationStructureSize;
-		check_vk_result(vkCreateAccelerationStructureKHR(device, &asCreateInfo, nullptr, &bottomLevelAS.handle));
+		if (level.blas.handle == VK_NULL_HANDLE) createAccelerationStructure(level.blas, VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, sizeInfo, host);
+		buildInfo.dstAccelerationStructure = level.blas.handle;
+		build.scratchSize = sizeInfo.buildScratchSize;
+		build.updateScratchSize = (buildInfo.flags & VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR) ? sizeInfo.updateScratchSize : 0;
+	}
 
-		VkAccelerationStructureBuildRangeInfoKHR rangeInfo = {};
-		rangeInfo.primitiveCount = primitiveCount;
+	// scratch one vkCmdBuildAccelerationStructuresKHR may use, larger scenes are split into several calls
+	constexpr VkDeviceSize BLAS_BATCH_SCRATCH_BUDGET = 128ull * 1024 * 1024;
+
+	/*
+	Records every build in one command buffer and submits it once. Builds are grouped into calls whose scratch fits
+	BLAS_BATCH_SCRATCH_BUDGET (a single build larger than that gets a call of its own), every call reuses the same
+	scratch ranges, so consecutive calls are separated by a barrier on the scratch writes.
+	With compactedSizes, query i receives the compacted size of the i-th build with ALLOW_COMPACTION, written after
+	the last build. With timestamps, queries 0 and 1 bracket all calls.
+	Returns the number of build calls.
+	*/
+	uint32_t MainVulkApplication::buildBLASBatches(std::vector<BlasBuild>& builds, VkQueryPool compactedSizes, VkQueryPool timestamps) {
+		if (builds.empty()) return 0;
+
+		std::vector<size_t> batchStarts;
+		VkDeviceSize batchFootprint = 0, largestFootprint = 0;
+		for (size_t i = 0; i < builds.size(); ++i) {
+			// pGeometries was taken before the vector was final
+			builds[i].buildInfo.pGeometries = &builds[i].geometry;
+			const VkDeviceSize footprint = scratchFootprint(builds[i].scratchSize);
+			if (batchStarts.empty() || batchFootprint + footprint > BLAS_BATCH_SCRATCH_BUDGET) {
+				batchStarts.push_back(i);
+				batchFootprint = 0;
+			}
+			batchFootprint += footprint;
+			largestFootprint = std::max(largestFootprint, batchFootprint);
+		}
+		batchStarts.push_back(builds.size());
+
+		std::vector<VkAccelerationStructureBuildGeometryInfoKHR> buildInfos;
+		std::vector<const VkAccelerationStructureBuildRangeInfoKHR*> rangeInfos;
+		buildInfos.reserve(builds.size());
+		rangeInfos.reserve(builds.size());
+
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+		barrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+
+		std::vector<VkAccelerationStructureKHR> compactable;
+		for (const BlasBuild& build : builds)
+			if (build.buildInfo.flags & VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR) compactable.push_back(build.buildInfo.dstAccelerationStructure);
+
+		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+		// updateObjectBLAS builds into structures that frames submitted earlier may still trace
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+			0, 0, nullptr, 0, nullptr, 0, nullptr);
+		if (compactedSizes != VK_NULL_HANDLE && !compactable.empty())
+			vkCmdResetQueryPool(commandBuffer, compactedSizes, 0, static_cast<uint32_t>(compactable.size()));
+		if (timestamps != VK_NULL_HANDLE) {
+			vkCmdResetQueryPool(commandBuffer, timestamps, 0, 2);
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestamps, 0);
+		}
+		for (size_t b = 0; b + 1 < batchStarts.size(); ++b) {
+			if (b > 0) vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+				VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+			resetScratch(largestFootprint);
+			const size_t first = buildInfos.size();
+			for (size_t i = batchStarts[b]; i < batchStarts[b + 1]; ++i) {
+				builds[i].buildInfo.scratchData.deviceAddress = allocateScratch(builds[i].scratchSize);
+				buildInfos.push_back(builds[i].buildInfo);
+				rangeInfos.push_back(&builds[i].rangeInfo);
+			}
+			vkCmdBuildAccelerationStructuresKHR(commandBuffer, static_cast<uint32_t>(buildInfos.size() - first),
+				buildInfos.data() + first, rangeInfos.data() + first);
+		}
+		// the TLAS build and the compacted size queries read the results
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+			VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+		if (timestamps != VK_NULL_HANDLE) vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, timestamps, 1);
+		if (compactedSizes != VK_NULL_HANDLE && !compactable.empty())
+			vkCmdWriteAccelerationStructuresPropertiesKHR(commandBuffer, static_cast<uint32_t>(compactable.size()), compactable.data(),
+				VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR, compactedSizes, 0);
+		endSingleTimeCommands(commandBuffer);
+
+		return static_cast<uint32_t>(batchStarts.size() - 1);
+	}
+
+	/*
+	Builds on the cpu with vkBuildAccelerationStructuresKHR, the builds come from prepareBLAS with host = true.
+	One deferred operation takes all of them, the calling thread and up to threads - 1 workerPool threads join it
+	until the driver has no work left for them, so the builds spread over the cores. It blocks the caller like the
+	queue path does. threads 0 joins as many as the driver reports useful and the pool has.
+	Scratch is one block of host memory. Returns the number of threads that actually entered the join, a pool thread
+	that starts after the operation finished is not counted.
+	*/
+	uint32_t MainVulkApplication::buildBLASHost(std::vector<BlasBuild>& builds, uint32_t threads) {
+		if (builds.empty()) return 0;
+		if (!workerPool) workerPool = std::make_unique<ThreadPool>();
+
+		constexpr size_t HOST_SCRATCH_ALIGNMENT = 256;
+		size_t scratchBytes = 0;
+		for (const BlasBuild& build : builds) scratchBytes += align_up<size_t>(static_cast<size_t>(build.scratchSize), HOST_SCRATCH_ALIGNMENT);
+		std::unique_ptr<uint8_t[]> scratch(new uint8_t[scratchBytes + HOST_SCRATCH_ALIGNMENT]);
+		uintptr_t scratchHead = align_up<uintptr_t>(reinterpret_cast<uintptr_t>(scratch.get()), HOST_SCRATCH_ALIGNMENT);
+
+		std::vector<VkAccelerationStructureBuildGeometryInfoKHR> buildInfos;
+		std::vector<const VkAccelerationStructureBuildRangeInfoKHR*> rangeInfos;
+		buildInfos.reserve(builds.size());
+		rangeInfos.reserve(builds.size());
+		for (BlasBuild& build : builds) {
+			build.buildInfo.pGeometries = &build.geometry;
+			build.buildInfo.scratchData.hostAddress = reinterpret_cast<void*>(scratchHead);
+			scratchHead += align_up<size_t>(static_cast<size_t>(build.scratchSize), HOST_SCRATCH_ALIGNMENT);
+			buildInfos.push_back(build.buildInfo);
+			rangeInfos.push_back(&build.rangeInfo);
+		}
+
+		VkDeferredOperationKHR operation;
+		check_vk_result(vkCreateDeferredOperationKHR(device, nullptr, &operation));
+		VkResult result = vkBuildAccelerationStructuresKHR(device, operation, static_cast<uint32_t>(buildInfos.size()), buildInfos.data(), rangeInfos.data());
+
+		uint32_t joined = 1;
+		if (result == VK_OPERATION_DEFERRED_KHR) {
+			const uint32_t available = static_cast<uint32_t>(workerPool->size()) + 1;
+			uint32_t wanted = std::min(threads ? threads : available, available);
+			wanted = std::max(1u, std::min(wanted, vkGetDeferredOperationMaxConcurrencyKHR(device, operation)));
+			// THREAD_IDLE : work is left but none for this thread yet, THREAD_DONE : none is left for it, SUCCESS : all finished
+			std::atomic<uint32_t> entered{ 0 };
+			workerPool->parallelFor(wanted, [&](size_t) {
+				VkResult joinResult = vkDeferredOperationJoinKHR(device, operation);
+				if (joinResult == VK_THREAD_DONE_KHR) return;
+				entered.fetch_add(1, std::memory_order_relaxed);
+				while (joinResult == VK_THREAD_IDLE_KHR) {
+					std::this_thread::yield();
+					joinResult = vkDeferredOperationJoinKHR(device, operation);
+				}
+			});
+			result = vkGetDeferredOperationResultKHR(device, operation);
+			joined = std::max(1u, entered.load());
+		}
+		else if (result == VK_OPERATION_NOT_DEFERRED_KHR) result = VK_SUCCESS;
+		vkDestroyDeferredOperationKHR(device, operation, nullptr);
+		check_vk_result(result);
+		return joined;
+	}
+
+	void MainVulkApplication::createBLAS() {
+
+		using std::cout; using std::endl;
+		auto startTime = std::chrono::high_resolution_clock::now();
+
+		size_t blasCount = 0;
+		for (const auto& entry : scene.objects) blasCount += entry.second.lods.size();
+
+		// cpu builds when the device can, except for structures updateObjectBLAS builds again on the queue,
+		// those need the device build sizes
+		const bool hostBuilds = hostBuildSupported && loadOptions.hostBLASBuilds && geometry.vertices && geometry.indices;
+
+		// levels the policy lets compaction shrink, in build order like the queries
+		std::vector<BlasBuild> builds, hostBuildList;
+		std::vector<LodLevel*> levels, hostLevels;
+		builds.reserve(blasCount);
+		for (auto& entry : scene.objects) {
+			SceneObject& object = entry.second;
+			const bool host = hostBuilds && !asBuildRefits(object.buildPolicy);
+			std::vector<BlasBuild>& target = host ? hostBuildList : builds;
+			for (LodLevel& level : object.lods) {
+				target.emplace_back();
+				prepareBLAS(object, level, target.back(), AsBuildPolicy::Auto, host);
+				if (host) hostLevels.push_back(&level);
+				if (target.back().buildInfo.flags & VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR) levels.push_back(&level);
+			}
+		}
+
+		VkQueryPool compactedSizes = VK_NULL_HANDLE;
+		if (!levels.empty()) {
+			VkQueryPoolCreateInfo queryPoolInfo{};
+			queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			queryPoolInfo.queryType = VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR;
+			queryPoolInfo.queryCount = static_cast<uint32_t>(levels.size());
+			check_vk_result(vkCreateQueryPool(device, &queryPoolInfo, nullptr, &compactedSizes));
+		}
+		const uint32_t calls = buildBLASBatches(builds, hostBuildList.empty() ? compactedSizes : VK_NULL_HANDLE);
+
+		uint32_t hostThreads = 0;
+		double hostMs = 0.0;
+		if (!hostBuildList.empty()) {
+			auto hostStart = std::chrono::high_resolution_clock::now();
+			hostThreads = buildBLASHost(hostBuildList);
+			hostMs = elapsedMs(hostStart, std::chrono::high_resolution_clock::now());
+
+			// the sizes of every compactable level at once, the compacted copies land in device local memory
+			if (compactedSizes != VK_NULL_HANDLE) {
+				std::vector<VkAccelerationStructureKHR> handles;
+				for (const LodLevel* level : levels) handles.push_back(level->blas.handle);
+				VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+				vkCmdResetQueryPool(commandBuffer, compactedSizes, 0, static_cast<uint32_t>(handles.size()));
+				vkCmdWriteAccelerationStructuresPropertiesKHR(commandBuffer, static_cast<uint32_t>(handles.size()), handles.data(),
+					VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR, compactedSizes, 0);
+				endSingleTimeCommands(commandBuffer);
+			}
+		}
+
+		if (compactedSizes != VK_NULL_HANDLE) {
+			// worst case sizes per object, for the report below
+			std::unordered_map<uint64_t, VkDeviceSize> builtSizes;
+			for (const auto& entry : scene.objects)
+				for (const LodLevel& level : entry.second.lods) builtSizes[entry.first] += level.blas.size;
+
+			compactBLAS(levels, compactedSizes);
+			vkDestroyQueryPool(device, compactedSizes, nullptr);
+
+			VkDeviceSize builtTotal = 0, compactTotal = 0;
+			for (const auto& entry : scene.objects) {
+				VkDeviceSize compactSize = 0;
+				for (const LodLevel& level : entry.second.lods) compactSize += level.blas.size;
+				const VkDeviceSize builtSize = builtSizes[entry.first];
+				builtTotal += builtSize;
+				compactTotal += compactSize;
+				cout << "BLAS compaction : " << (entry.second.name.empty() ? "mesh " + std::to_string(entry.second.geometryIndex) : entry.second.name)
+					<< " " << builtSize / 1024.0 << " KB -> " << compactSize / 1024.0 << " KB" << endl;
+			}
+			cout << "BLAS compaction : " << builtTotal / (1024.0 * 1024.0) << " MB -> " << compactTotal / (1024.0 * 1024.0) << " MB" << endl;
+		}
+
+		// what compaction skipped or never applied to is still host visible, the gpu traces it from device local memory
+		cloneBLASDeviceLocal(hostLevels);
+
+		for (auto& entry : scene.objects) entry.second.blas = entry.second.lods[0].blas;
+		for (SceneInstance& instance : scene.instances) instance.lod = 0;
+
+		cout << "BLAS : " << blasCount << " over " << scene.objects.size() << " objects (" << scene.instances.size() << " instances) in "
+			<< calls << " build calls, one submit, ";
+		if (!hostBuildList.empty()) cout << hostBuildList.size() << " built on the host by " << hostThreads << " threads in " << hostMs << " ms, ";
+		cout << elapsedMs(startTime, std::chrono::high_resolution_clock::now()) << " ms" << endl;
+	}
+
+	/*
+	Copies every built BLAS into a structure of its queried compacted size with MODE_COMPACT, all copies in one
+	submission, then releases the worst case originals. Query i belongs to levels[i].
+	*/
+	void MainVulkApplication::compactBLAS(const std::vector<LodLevel*>& levels, VkQueryPool compactedSizes) {
+		std::vector<VkDeviceSize> sizes(levels.size());
+		check_vk_result(vkGetQueryPoolResults(device, compactedSizes, 0, static_cast<uint32_t>(sizes.size()), sizes.size() * sizeof(VkDeviceSize),
+			sizes.data(), sizeof(VkDeviceSize), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+
+		std::vector<AccelerationStructure> originals(levels.size());
+		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+		for (size_t i = 0; i < levels.size(); ++i) {
+			AccelerationStructure& blas = levels[i]->blas;
+			// nothing to gain, keep the original
+			if (sizes[i] == 0 || sizes[i] >= blas.size) continue;
+
+			VkAccelerationStructureBuildSizesInfoKHR sizeInfo{};
+			sizeInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
+			sizeInfo.accelerationStructureSize = sizes[i];
+			AccelerationStructure compacted;
+			createAccelerationStructure(compacted, VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, sizeInfo);
+
+			VkCopyAccelerationStructureInfoKHR copyInfo{};
+			copyInfo.sType = VK_STRUCTURE_TYPE_COPY_ACCELERATION_STRUCTURE_INFO_KHR;
+			copyInfo.src = blas.handle;
+			copyInfo.dst = compacted.handle;
+			copyInfo.mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_COMPACT_KHR;
+			vkCmdCopyAccelerationStructureKHR(commandBuffer, &copyInfo);
+
+			originals[i] = blas;
+			blas = compacted;
+		}
+		// the TLAS build reads the compacted copies
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+		barrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+			VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+		endSingleTimeCommands(commandBuffer);
+
+		for (AccelerationStructure& original : originals) destroyAccelerationStructure(original);
+	}
+
+	/*
+	Moves every level still in host visible memory (buildBLASHost wrote it through the mapping) into a device local
+	structure of the same size with MODE_CLONE, one submission, then releases the host visible originals.
+	Compacted levels already live in device local memory and are skipped.
+	*/
+	void MainVulkApplication::cloneBLASDeviceLocal(const std::vector<LodLevel*>& levels) {
+		std::vector<AccelerationStructure> originals;
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		for (LodLevel* level : levels) {
+			AccelerationStructure& blas = level->blas;
+			if (!blas.hostVisible) continue;
+			if (commandBuffer == VK_NULL_HANDLE) commandBuffer = beginSingleTimeCommands();
+
+			VkAccelerationStructureBuildSizesInfoKHR sizeInfo{};
+			sizeInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
+			sizeInfo.accelerationStructureSize = blas.size;
+			AccelerationStructure deviceLocal;
+			createAccelerationStructure(deviceLocal, VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, sizeInfo);
+
+			VkCopyAccelerationStructureInfoKHR copyInfo{};
+			copyInfo.sType = VK_STRUCTURE_TYPE_COPY_ACCELERATION_STRUCTURE_INFO_KHR;
+			copyInfo.src = blas.handle;
+			copyInfo.dst = deviceLocal.handle;
+			copyInfo.mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_CLONE_KHR;
+			vkCmdCopyAccelerationStructureKHR(commandBuffer, &copyInfo);
+
+			originals.push_back(blas);
+			blas = deviceLocal;
+		}
+		if (commandBuffer == VK_NULL_HANDLE) return;
+
+		// the TLAS build reads the clones
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+		barrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+			VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+		endSingleTimeCommands(commandBuffer);
 
-		const VkAccelerationStructureBuildRangeInfoKHR* rangeInfos[] = { &rangeInfo };
+		for (AccelerationStructure& original : originals) destroyAccelerationStructure(original);
+	}
 
-		vkCmdBuildAccelerationStructuresKHR(cmdBuffer, 1, &buildInfo, rangeInfos);
+	/*
+	Coarsest level whose triangle count still covers the instance's projected area at loadOptions.lodPixelsPerTriangle.
+	The bounding sphere is projected with the camera of the last updateUniformBuffer, a level only gets coarser once
+	it would also hold LOD_HYSTERESIS times the demand so instances near a threshold do not rebuild the TLAS every frame.
+	Returns true when any instance changed level.
+	*/
+	constexpr float LOD_HYSTERESIS = 1.25f;
 
+	// where the TLAS places the instance, ubo.model only turns the raster preview, the traced scene stays put
+	glm::mat4 MainVulkApplication::instanceWorld(const SceneInstance& instance) const {
+		return instance.transform * scene.objects.at(instance.objectId).transform;
+	}
+
+	bool MainVulkApplication::selectLods() {
+
+		// no frame drawn yet, full detail
+		const float focal = fabsf(ubo.proj[1][1]);
+		if (focal == 0.0f) return false;
+
+		const glm::vec3 eye = glm::vec3(glm::inverse(ubo.view)[3]);
+		const float halfHeight = 0.5f * static_cast<float>(swapChainExtent.height);
+
+		bool changed = false;
+		for (SceneInstance& instance : scene.instances) {
+			const SceneObject& object = scene.objects.at(instance.objectId);
+			if (object.lods.size() < 2) continue;
+
+			// the traced placement, so the level follows what the rays see
+			const glm::mat4 world = instanceWorld(instance);
+			const glm::vec3 center = glm::vec3(world * glm::vec4(object.boundsCenter, 1.0f));
+			const float scale = std::max({ glm::length(glm::vec3(world[0])), glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2])) });
+			const float radius = object.boundsRadius * scale;
+			const float distance = glm::length(center - eye);
+
+			uint32_t level = 0;
+			if (distance > radius) {
+				const float radiusPixels = radius * focal * halfHeight / distance;
+				const float demand = glm::pi<float>() * radiusPixels * radiusPixels / loadOptions.lodPixelsPerTriangle;
+
+				auto pick = [&](float triangles) {
+					for (uint32_t l = static_cast<uint32_t>(object.lods.size()) - 1; l > 0; --l)
+						if (object.lods[l].indexCount / 3 >= triangles) return l;
+					return 0u;
+				};
+				level = pick(demand);
+				if (level > instance.lod) level = std::max(instance.lod, pick(demand * LOD_HYSTERESIS));
+			}
+
+			if (level != instance.lod) {
+				instance.lod = level;
+				changed = true;
+			}
+		}
+		return changed;
 	}
 
 	/* 
@@ -74,26 +479,230 @@ Would you like an example setup for handling materials and textures in Vulkan RT
 	Instead, it contains instances of BLASs. Each instance defines a transformation (such as translation, rotation, or scaling) and a BLAS to apply it to. 
 	When ray tracing, the system starts from the TLAS and works its way down to the appropriate BLAS.
 	The TLAS essentially acts as a directory that guides the system to the correct BLAS based on the ray’s path.
-```*/
-
+	
+	One VkAccelerationStructureInstanceKHR per SceneInstance, pointing at the BLAS of its current LOD level, so repeated
+	meshes share their BLAS chain. Called once at startup and every frame, without a host stall:
+		every frame in flight writes its own mapped instance buffer, its fence at the top of drawFrame retired the last reader
+		transform only edits (moveInstance) refit the TLAS in MODE_UPDATE, src = dst, against the same instance count
+		LOD switches, moved BLAS, another instance count or tlasRefitLimit refits in a row run a full build instead
+		the frame's tlasCommandBuffer is submitted ahead of the frame, the barriers around the build order it after the
+		previous frame's traces and before this one's, all frames share one TLAS
+	So builds and refits serialize the frames in flight : the ALL_COMMANDS -> AS_BUILD barrier makes every update wait
+	for the traces of the frame before it, a TLAS per frame in flight would remove that wait at MAX_FRAMES_IN_FLIGHT
+	times the memory.
+	Refits only stretch the boxes of the old hierarchy, the periodic build restores trace quality.
+	The handle only changes when the instance count outgrows the TLAS, that waits for the queue and rewrites the descriptor.
+	*/
 	void MainVulkApplication::createTLAS() {
-
-		VkAccelerationStructureInstanceKHR instance = {};
-		instance.transform = ConvertToVkTransformMatrix(objectTransform);
-		instance.instanceCustomIndex = objectID;
-		instance.mask = 0xFF; // Visibility mask
-		instance.instanceShaderBindingTableRecordOffset = 0;
-		instance.accelerationStructureReference = GetASDeviceAddress(blas);
+		const uint32_t frame = static_cast<uint32_t>(currentFrame);
+		// the frame's fence has signalled, so has the build it submitted last time
+		if (tlasTimestamped[frame]) {
+			uint64_t timestamps[2] = {};
+			if (vkGetQueryPoolResults(device, tlasQueryPool, frame * 2, 2, sizeof(timestamps), timestamps, sizeof(uint64_t),
+				VK_QUERY_RESULT_64_BIT) == VK_SUCCESS)
+				tlasStats.gpuMs = double(timestamps[1] - timestamps[0]) * tlasTickMs;
+			tlasTimestamped[frame] = false;
+		}
+
+		const bool changed = selectLods();
+		const uint32_t instanceCount = static_cast<uint32_t>(scene.instances.size());
+		if (instanceCount == 0) return;
+
+		const bool first = topLevelAS.handle == VK_NULL_HANDLE;
+		const bool rebuild = first || changed || tlasDirty || instanceCount != tlasBuiltInstances;
+		if (!rebuild && !tlasTransformsDirty) return;
+		const bool refit = !rebuild && tlasRefits < loadOptions.tlasRefitLimit;
+		tlasDirty = false;
+		tlasTransformsDirty = false;
+
+		const auto start = std::chrono::high_resolution_clock::now();
+
+		VkAccelerationStructureGeometryKHR tlasGeometry = {};
+		tlasGeometry.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
+		tlasGeometry.geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR;
+		tlasGeometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
+		tlasGeometry.geometry.instances.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR;
+		tlasGeometry.geometry.instances.arrayOfPointers = VK_FALSE;
 
 		VkAccelerationStructureBuildGeometryInfoKHR tlasBuildInfo = {};
 		tlasBuildInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
 		tlasBuildInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
-		tlasBuildInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+		tlasBuildInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR;
 		tlasBuildInfo.geometryCount = 1;
 		tlasBuildInfo.pGeometries = &tlasGeometry;
 
+		if (instanceCount > tlasInstanceCapacity) {
+			if (!first) {
+				// frames in flight still trace the old TLAS and read the old instances
+				vkQueueWaitIdle(graphicsQueue);
+				destroyTLAS();
+				tlasStats.reallocations++;
+			}
+
+			for (uint32_t f = 0; f < MAX_FRAMES_IN_FLIGHT; ++f)
+				createBuffer(sizeof(VkAccelerationStructureInstanceKHR) * instanceCount,
+					VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR,
+					VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+					tlasInstanceBuffers[f], tlasInstanceBufferMemory[f], true, MemoryCategory::TLAS);
+
+			VkAccelerationStructureBuildSizesInfoKHR sizeInfo = {};
+			sizeInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
+			vkGetAccelerationStructureBuildSizesKHR(device, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &tlasBuildInfo, &instanceCount, &sizeInfo);
+			createAccelerationStructure(topLevelAS, VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR, sizeInfo);
+
+			// builds and refits take the same range, one alignment of slack like the pool
+			tlasScratch.capacity = std::max(sizeInfo.buildScratchSize, sizeInfo.updateScratchSize) + scratchFootprint(1);
+			createBuffer(tlasScratch.capacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, tlasScratch.handle, tlasScratch.memory, true, MemoryCategory::Scratch);
+			tlasScratch.deviceAddress = GetBufferDeviceAddress(tlasScratch.handle);
+			tlasScratch.grows++;
+			tlasInstanceCapacity = instanceCount;
+
+			if (tlasQueryPool == VK_NULL_HANDLE) {
+				VkQueryPoolCreateInfo queryPoolInfo{};
+				queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+				queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+				queryPoolInfo.queryCount = 2 * MAX_FRAMES_IN_FLIGHT;
+				check_vk_result(vkCreateQueryPool(device, &queryPoolInfo, nullptr, &tlasQueryPool));
+
+				VkPhysicalDeviceProperties deviceProperties;
+				vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+				tlasTickMs = deviceProperties.limits.timestampPeriod * 1e-6;
+			}
+
+			if (!first) writeTlasDescriptor();
+		}
+
+		VkAccelerationStructureInstanceKHR* instances = static_cast<VkAccelerationStructureInstanceKHR*>(tlasInstanceBufferMemory[frame].mapped);
+		for (uint32_t i = 0; i < instanceCount; ++i) {
+			const SceneInstance& sceneInstance = scene.instances[i];
+			const SceneObject& object = scene.objects.at(sceneInstance.objectId);
+			const LodLevel& level = object.lods[sceneInstance.lod];
+
+			VkAccelerationStructureInstanceKHR instance = {};
+			// VkTransformMatrixKHR is a row major 3x4, glm is column major
+			const glm::mat4 rows = glm::transpose(instanceWorld(sceneInstance));
+			memcpy(&instance.transform, &rows, sizeof(VkTransformMatrixKHR));
+			instance.instanceCustomIndex = level.meshInfoIndex;
+			instance.mask = 0xFF; // Visibility mask
+			instance.instanceShaderBindingTableRecordOffset = 0;
+			instance.flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
+			instance.accelerationStructureReference = level.blas.deviceAddress;
+			instances[i] = instance;
+		}
+
+		tlasGeometry.geometry.instances.data.deviceAddress = GetBufferDeviceAddress(tlasInstanceBuffers[frame]);
+		tlasBuildInfo.mode = refit ? VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR : VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+		tlasBuildInfo.srcAccelerationStructure = refit ? topLevelAS.handle : VK_NULL_HANDLE;
+		tlasBuildInfo.dstAccelerationStructure = topLevelAS.handle;
+		tlasBuildInfo.scratchData.deviceAddress = align_up<VkDeviceAddress>(tlasScratch.deviceAddress, scratchFootprint(1));
 
+		VkAccelerationStructureBuildRangeInfoKHR rangeInfo = {};
+		rangeInfo.primitiveCount = instanceCount;
+		const VkAccelerationStructureBuildRangeInfoKHR* buildRangeInfos[] = { &rangeInfo };
+
+		// the startup build waits like every other setup upload, later ones go ahead of their frame
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		if (first) commandBuffer = beginSingleTimeCommands();
+		else {
+			if (tlasCommandBuffers[frame] == VK_NULL_HANDLE) {
+				VkCommandBufferAllocateInfo allocInfo{};
+				allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+				allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+				allocInfo.commandPool = commandPool;
+				allocInfo.commandBufferCount = 1;
+				check_vk_result(vkAllocateCommandBuffers(device, &allocInfo, &tlasCommandBuffers[frame]));
+			}
+			// the pool resets command buffers on begin
+			commandBuffer = tlasCommandBuffers[frame];
+			VkCommandBufferBeginInfo beginInfo{};
+			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			check_vk_result(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+		}
+
+		// earlier traces are done with the TLAS, the earlier build with the scratch, BLAS builds and defrag copies are visible
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR | VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+			0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+		vkCmdResetQueryPool(commandBuffer, tlasQueryPool, frame * 2, 2);
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, tlasQueryPool, frame * 2);
+		vkCmdBuildAccelerationStructuresKHR(commandBuffer, 1, &tlasBuildInfo, buildRangeInfos);
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, tlasQueryPool, frame * 2 + 1);
+
+		// the traces of this frame, and a defrag pass cloning the TLAS, see the finished build
+		barrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+		barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+			0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+		if (first) endSingleTimeCommands(commandBuffer);
+		else {
+			check_vk_result(vkEndCommandBuffer(commandBuffer));
+			VkSubmitInfo submitInfo{};
+			submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers = &commandBuffer;
+			check_vk_result(vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE));
+		}
+		tlasTimestamped[frame] = true;
+
+		if (refit) {
+			tlasRefits++;
+			tlasStats.refits++;
+		}
+		else {
+			tlasRefits = 0;
+			tlasBuiltInstances = instanceCount;
+			tlasStats.builds++;
+		}
+		tlasStats.cpuMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
 
+	// transform only edit of a placed instance, the next createTLAS refits instead of rebuilding
+	void MainVulkApplication::moveInstance(uint32_t instance, const glm::mat4& transform) {
+		SceneInstance& sceneInstance = scene.instances.at(instance);
+		sceneInstance.transform = transform;
+		// the BLAS is unaffected, the class only tells the report and the next policy pass
+		SceneObject& object = scene.objects.at(sceneInstance.objectId);
+		object.motion = std::max(object.motion, ObjectMotion::Rigid);
+		tlasTransformsDirty = true;
+	}
+
+	/*
+	Debug driver of the refit path, set from the memory panel : the first animatedInstances placements circle around
+	where they were loaded, half their bounding radius wide, so every frame is a transform only edit and
+	tlasStats.gpuMs reads as the refit cost of that many moving instances. Lowering the count puts the rest back.
+	*/
+	void MainVulkApplication::animateInstances(float time) {
+		const uint32_t count = std::min(animatedInstances, static_cast<uint32_t>(scene.instances.size()));
+		for (uint32_t i = count; i < animationBaseTransforms.size(); ++i) moveInstance(i, animationBaseTransforms[i]);
+		if (animationBaseTransforms.size() > count) animationBaseTransforms.resize(count);
+		while (animationBaseTransforms.size() < count) animationBaseTransforms.push_back(scene.instances[animationBaseTransforms.size()].transform);
+
+		for (uint32_t i = 0; i < count; ++i) {
+			const SceneObject& object = scene.objects.at(scene.instances[i].objectId);
+			const float phase = time * 2.0f + static_cast<float>(i);
+			const glm::vec3 offset = 0.5f * object.boundsRadius * glm::vec3(cosf(phase), sinf(phase), 0.0f);
+			moveInstance(i, glm::translate(glm::mat4(1.0f), offset) * animationBaseTransforms[i]);
+		}
+	}
+
+	// the TLAS, its instance buffers and scratch, the caller makes sure no frame still uses them
+	void MainVulkApplication::destroyTLAS() {
+		destroyAccelerationStructure(topLevelAS);
+		for (uint32_t f = 0; f < MAX_FRAMES_IN_FLIGHT; ++f) {
+			destroyBuffer(tlasInstanceBuffers[f], tlasInstanceBufferMemory[f]);
+			tlasTimestamped[f] = false;
+		}
+		destroyBuffer(tlasScratch.handle, tlasScratch.memory);
+		tlasScratch.capacity = 0;
+		tlasInstanceCapacity = 0;
+		tlasBuiltInstances = 0;
 	}
 
 
@@ -133,8 +742,8 @@ Would you like an example setup for handling materials and textures in Vulkan RT
 
 		createAccelerationStructure(bottomLevelAS, VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, accelerationStructureBuildSizesInfo);
 
-		// Create a small scratch buffer used during build of the bottom level acceleration structure
-		createScratchBuffer(accelerationStructureBuildSizesInfo.buildScratchSize);
+		// scratch range for the build of the bottom level acceleration structure
+		resetScratch(scratchFootprint(accelerationStructureBuildSizesInfo.buildScratchSize));
 
 		VkAccelerationStructureBuildGeometryInfoKHR accelerationBuildGeometryInfo{};
 		accelerationBuildGeometryInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
@@ -144,11 +753,11 @@ Would you like an example setup for handling materials and textures in Vulkan RT
 		accelerationBuildGeometryInfo.dstAccelerationStructure = bottomLevelAS.handle;
 		accelerationBuildGeometryInfo.geometryCount = 1;
 		accelerationBuildGeometryInfo.pGeometries = &accelerationStructureGeometry;
-		accelerationBuildGeometryInfo.scratchData.deviceAddress = scratchBuffer.deviceAddress;
+		accelerationBuildGeometryInfo.scratchData.deviceAddress = allocateScratch(accelerationStructureBuildSizesInfo.buildScratchSize);
 
 		VkAccelerationStructureBuildRangeInfoKHR accelerationStructureBuildRangeInfo{};
 		accelerationStructureBuildRangeInfo.primitiveCount = aabbCount;
-		std::vector<VkAccelerationStructureBuildRangeInfoKHR*> accelerationBuildStructureRangeInfos = { &accelerationStructureBuildRangeInfo };
+		const VkAccelerationStructureBuildRangeInfoKHR* accelerationBuildStructureRangeInfos[] = { &accelerationStructureBuildRangeInfo };
 
 		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
 
@@ -158,15 +767,10 @@ Would you like an example setup for handling materials and textures in Vulkan RT
 			commandBuffer,
 			1,
 			&accelerationBuildGeometryInfo,
-			accelerationBuildStructureRangeInfos.data());
+			accelerationBuildStructureRangeInfos);
 
 		endSingleTimeCommands(commandBuffer);
 
-		if (scratchBuffer.memory != VK_NULL_HANDLE)
-			vkFreeMemory(device, scratchBuffer.memory, nullptr);
-		if (scratchBuffer.handle != VK_NULL_HANDLE)
-			vkDestroyBuffer(device, scratchBuffer.handle, nullptr);
-
 		VkTransformMatrixKHR transformMatrix = {
 			1.0f, 0.0f, 0.0f, 0.0f,
 			0.0f, 1.0f, 0.0f, 0.0f,
@@ -181,19 +785,13 @@ Would you like an example setup for handling materials and textures in Vulkan RT
 		instance.accelerationStructureReference = bottomLevelAS.deviceAddress;
 
 		// Buffer for instance data
-		VkBuffer instancesBuffer; VkDeviceMemory instancesBufferMemory;
+		VkBuffer instancesBuffer; MemoryAllocation instancesBufferMemory;
 		createBuffer(sizeof(VkAccelerationStructureInstanceKHR),
 			VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			instancesBuffer, instancesBufferMemory, true);
-
-		void* mappedInstance = nullptr;
+			instancesBuffer, instancesBufferMemory, true, MemoryCategory::TLAS);
 
-		check_vk_result(vkMapMemory(device, instancesBufferMemory, 0,
-			sizeof(VkAccelerationStructureInstanceKHR), 0, &mappedInstance));
-		memcpy(mappedInstance, &instance, sizeof(VkAccelerationStructureInstanceKHR));
-		vkUnmapMemory(device, instancesBufferMemory);
-		mappedInstance = NULL;
+		memcpy(instancesBufferMemory.mapped, &instance, sizeof(VkAccelerationStructureInstanceKHR));
 
 		VkDeviceOrHostAddressConstKHR instanceDataDeviceAddress{};
 		VkBufferDeviceAddressInfoKHR bufferDeviceAInstance{};
@@ -230,8 +828,8 @@ Would you like an example setup for handling materials and textures in Vulkan RT
 
 		createAccelerationStructure(topLevelAS, VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR, accelerationStructureBuildSizesInfoI);
 
-		// Create a small scratch buffer used during build of the top level acceleration structure
-		createScratchBuffer(accelerationStructureBuildSizesInfoI.buildScratchSize);
+		// scratch range for the build of the top level acceleration structure, the BLAS build above has finished
+		resetScratch(scratchFootprint(accelerationStructureBuildSizesInfoI.buildScratchSize));
 
 		VkAccelerationStructureBuildGeometryInfoKHR accelerationBuildGeometryInfoTop{};
 		accelerationBuildGeometryInfoTop.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
@@ -241,7 +839,7 @@ Would you like an example setup for handling materials and textures in Vulkan RT
 		accelerationBuildGeometryInfoTop.dstAccelerationStructure = topLevelAS.handle;
 		accelerationBuildGeometryInfoTop.geometryCount = 1;
 		accelerationBuildGeometryInfoTop.pGeometries = &accelerationStructureGeometryI;
-		accelerationBuildGeometryInfoTop.scratchData.deviceAddress = scratchBuffer.deviceAddress;
+		accelerationBuildGeometryInfoTop.scratchData.deviceAddress = allocateScratch(accelerationStructureBuildSizesInfoI.buildScratchSize);
 
 		VkAccelerationStructureBuildRangeInfoKHR accelerationStructureBuildRangeInfoTop{};
 		accelerationStructureBuildRangeInfoTop.primitiveCount = 1;
@@ -249,8 +847,7 @@ Would you like an example setup for handling materials and textures in Vulkan RT
 		accelerationStructureBuildRangeInfoTop.firstVertex = 0;
 		accelerationStructureBuildRangeInfoTop.transformOffset = 0;
 
-		accelerationBuildStructureRangeInfos.clear();
-		accelerationBuildStructureRangeInfos.push_back(&accelerationStructureBuildRangeInfoTop);
+		const VkAccelerationStructureBuildRangeInfoKHR* accelerationBuildStructureRangeInfosTop[] = { &accelerationStructureBuildRangeInfoTop };
 
 		VkCommandBuffer commandBuffer1 = beginSingleTimeCommands();
 		// Build the acceleration structure on the device via a one-time command buffer submission
@@ -260,17 +857,10 @@ Would you like an example setup for handling materials and textures in Vulkan RT
 			commandBuffer1,
 			1,
 			&accelerationBuildGeometryInfoTop,
-			accelerationBuildStructureRangeInfos.data());
+			accelerationBuildStructureRangeInfosTop);
 		endSingleTimeCommands(commandBuffer1);
 
-		if (scratchBuffer.memory != VK_NULL_HANDLE)
-			vkFreeMemory(device, scratchBuffer.memory, nullptr);
-		if (scratchBuffer.handle != VK_NULL_HANDLE)
-			vkDestroyBuffer(device, scratchBuffer.handle, nullptr);
-		if (instancesBuffer)
-			vkDestroyBuffer(device, instancesBuffer, nullptr);
-		if (instancesBufferMemory)
-			vkFreeMemory(device, instancesBufferMemory, nullptr);
+		destroyBuffer(instancesBuffer, instancesBufferMemory);
 
 	}
 
@@ -0,0 +1,102 @@
+#ifndef __VK_AS_POLICY_HPP__
+#define __VK_AS_POLICY_HPP__
+
+/*
+BLAS build policy per SceneObject, from how its geometry changes after load.
+
+	static     -> fast trace, compacted when loadOptions.compactBLAS, never built again
+	rigid      -> the same, the BLAS is in object space, only its TLAS instances move and the TLAS refits
+	deforming  -> fast build with ALLOW_UPDATE, no compaction, updateObjectBLAS refits it in place and rebuilds it
+	              every blasRefitLimit refits (refits only stretch the old boxes)
+
+Nothing in the renderer skins or morphs vertices yet. deformObjects is the debug driver until it does : it puts the
+first deformedObjects updatable objects through updateObjectBLAS every frame on unchanged vertices, which costs what
+a refit or rebuild of deformed ones would.
+
+The motion comes from the importers through MeshInstance.motion: placements under an animation channel are rigid,
+skins and morph targets deforming, an object takes the highest of its placements. moveInstance promotes a static
+object to rigid. loadOptions.buildPolicyOverrides replaces the choice per object name, benchmarkASBuildPolicies
+measures build, refit and trace time of every policy on the loaded scene.
+*/
+
+namespace VkApplication {
+
+	AsBuildPolicy defaultBuildPolicy(ObjectMotion motion, bool compact) {
+		if (motion == ObjectMotion::Deforming) return AsBuildPolicy::FastBuildUpdate;
+		return compact ? AsBuildPolicy::FastTraceCompact : AsBuildPolicy::FastTrace;
+	}
+
+	void MainVulkApplication::assignBuildPolicies() {
+		std::array<uint32_t, static_cast<size_t>(ObjectMotion::Count)> motions{};
+		std::array<uint32_t, static_cast<size_t>(AsBuildPolicy::Count)> policies{};
+		uint32_t overridden = 0;
+
+		for (auto& entry : scene.objects) {
+			SceneObject& object = entry.second;
+			auto custom = loadOptions.buildPolicyOverrides.find(object.name);
+			if (custom != loadOptions.buildPolicyOverrides.end() && custom->second != AsBuildPolicy::Auto) {
+				object.buildPolicy = custom->second;
+				overridden++;
+			}
+			else object.buildPolicy = defaultBuildPolicy(object.motion, loadOptions.compactBLAS);
+
+			motions[static_cast<size_t>(object.motion)]++;
+			policies[static_cast<size_t>(object.buildPolicy)]++;
+		}
+
+		std::cout << "build policy : " << motions[0] << " static, " << motions[1] << " rigid, " << motions[2] << " deforming ->";
+		for (uint32_t p = 1; p < static_cast<uint32_t>(AsBuildPolicy::Count); ++p)
+			if (policies[p]) std::cout << " " << policies[p] << " " << asBuildPolicyName(static_cast<AsBuildPolicy>(p)) << ",";
+		std::cout << " " << overridden << " overridden" << std::endl;
+	}
+
+	/*
+	The object's vertices changed in place. Every LOD level is refit (MODE_UPDATE, src = dst) when the policy
+	allows updates, otherwise rebuilt into its own structure, all in one submission. Handles and device addresses
+	stay the same, so the TLAS only needs a refit for the new bounds.
+	A compacted structure is too small to build into, those objects are static by definition.
+	*/
+	void MainVulkApplication::updateObjectBLAS(SceneObject& object) {
+		if (object.lods.empty()) return;
+		if (asBuildFlags(object.buildPolicy) & VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR)
+			throw std::runtime_error("updateObjectBLAS : " + object.name + " is compacted, it can not be built in place");
+		auto startTime = std::chrono::high_resolution_clock::now();
+
+		const bool refit = asBuildRefits(object.buildPolicy) && object.blasRefits < loadOptions.blasRefitLimit;
+		std::vector<BlasBuild> builds(object.lods.size());
+		for (size_t l = 0; l < object.lods.size(); ++l) {
+			prepareBLAS(object, object.lods[l], builds[l]);
+			if (!refit) continue;
+			builds[l].buildInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR;
+			builds[l].buildInfo.srcAccelerationStructure = object.lods[l].blas.handle;
+			builds[l].scratchSize = builds[l].updateScratchSize;
+		}
+		buildBLASBatches(builds);
+
+		object.blasRefits = refit ? object.blasRefits + 1 : 0;
+		object.blas = object.lods[0].blas;
+		tlasTransformsDirty = true;
+
+		if (refit) blasUpdateStats.refits++;
+		else blasUpdateStats.rebuilds++;
+		blasUpdateStats.lastMs = elapsedMs(startTime, std::chrono::high_resolution_clock::now());
+	}
+
+	/*
+	Debug driver of the BLAS update path, set from the memory panel : the first deformedObjects objects whose policy
+	refits (deforming ones, or overridden to an update policy) are updated every frame, so the refit / rebuild
+	cadence of blasRefitLimit and its cost show up in blasUpdateStats. The vertices stay as loaded.
+	*/
+	void MainVulkApplication::deformObjects() {
+		uint32_t remaining = deformedObjects;
+		for (auto& entry : scene.objects) {
+			if (remaining == 0) break;
+			SceneObject& object = entry.second;
+			if (!asBuildRefits(object.buildPolicy)) continue;
+			updateObjectBLAS(object);
+			remaining--;
+		}
+	}
+}
+
+#endif
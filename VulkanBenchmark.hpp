@@ -0,0 +1,746 @@
+#ifndef __VK_BENCHMARK_HPP__
+#define __VK_BENCHMARK_HPP__
+
+/*
+Timing runs for the loading / build paths, compiled in with RT_BENCHMARKS.
+Every run prints to stdout, nothing here is needed to render.
+*/
+
+#ifdef _WIN32
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace VkApplication {
+
+	// argv[0], benchmarkGLBImport starts it again with --import-rss to measure each importer in a fresh process
+	std::string benchmarkExecutable;
+
+	// high water mark of the process, only ever grows so one importer per process
+	uint64_t peakResidentBytes() {
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters{};
+		if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+		return counters.PeakWorkingSetSize;
+#else
+		struct rusage usage {};
+		if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+		return static_cast<uint64_t>(usage.ru_maxrss);
+#else
+		return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+	}
+
+	// best of a few runs so the first touch of fresh memory does not dominate
+	constexpr int BENCHMARK_RUNS = 3;
+
+	template <typename F>
+	double bestOfRuns(F&& fn) {
+		double best = std::numeric_limits<double>::max();
+		for (int run = 0; run < BENCHMARK_RUNS; ++run) {
+			auto start = std::chrono::high_resolution_clock::now();
+			fn();
+			best = std::min(best, elapsedMs(start, std::chrono::high_resolution_clock::now()));
+		}
+		return best;
+	}
+
+	// side x side vertex grid in a single aiMesh, 2 * (side - 1)^2 triangles, one aiFace per triangle like assimp hands it over
+	std::unique_ptr<aiScene> makeSyntheticScene(uint32_t side) {
+		auto scene = std::make_unique<aiScene>();
+		scene->mRootNode = new aiNode();
+		scene->mNumMeshes = 1;
+		scene->mMeshes = new aiMesh * [1];
+
+		aiMesh* mesh = new aiMesh();
+		scene->mMeshes[0] = mesh;
+		mesh->mPrimitiveTypes = aiPrimitiveType_TRIANGLE;
+		mesh->mNumVertices = side * side;
+		mesh->mVertices = new aiVector3D[mesh->mNumVertices];
+		mesh->mNormals = new aiVector3D[mesh->mNumVertices];
+		mesh->mTextureCoords[0] = new aiVector3D[mesh->mNumVertices];
+		mesh->mNumUVComponents[0] = 2;
+
+		const float invSide = 1.0f / float(side - 1);
+		for (uint32_t y = 0; y < side; ++y) {
+			for (uint32_t x = 0; x < side; ++x) {
+				uint32_t v = y * side + x;
+				mesh->mVertices[v] = aiVector3D(x * invSide, 0.0f, y * invSide);
+				mesh->mNormals[v] = aiVector3D(0.0f, 1.0f, 0.0f);
+				mesh->mTextureCoords[0][v] = aiVector3D(x * invSide, y * invSide, 0.0f);
+			}
+		}
+
+		mesh->mNumFaces = 2 * (side - 1) * (side - 1);
+		mesh->mFaces = new aiFace[mesh->mNumFaces];
+		uint32_t f = 0;
+		for (uint32_t y = 0; y + 1 < side; ++y) {
+			for (uint32_t x = 0; x + 1 < side; ++x) {
+				uint32_t v = y * side + x;
+				const uint32_t quad[2][3] = { { v, v + side, v + 1 }, { v + 1, v + side, v + side + 1 } };
+				for (const auto& tri : quad) {
+					aiFace& face = mesh->mFaces[f++];
+					face.mNumIndices = 3;
+					face.mIndices = new unsigned int[3]{ tri[0], tri[1], tri[2] };
+				}
+			}
+		}
+		return scene;
+	}
+
+	void printConvertTiming(const char* label, const aiScene* scene, ThreadPool& pool) {
+		std::vector<Vertex> benchVertices;
+		std::vector<uint32_t> benchIndices;
+		std::vector<MeshRange> benchRanges;
+
+		auto convertWith = [&](ThreadPool* convertPool) {
+			return bestOfRuns([&] {
+				// fresh arrays every run, reusing capacity would hide the sizing cost
+				std::vector<Vertex>().swap(benchVertices);
+				std::vector<uint32_t>().swap(benchIndices);
+				convertSceneMeshes(scene, benchVertices, benchIndices, benchRanges, convertPool);
+			});
+		};
+
+		double serialMs = convertWith(nullptr);
+		double parallelMs = convertWith(&pool);
+
+		using std::cout; using std::endl;
+		cout << label << " : " << benchRanges.size() << " meshes, " << benchVertices.size() << " vertices, "
+			<< benchIndices.size() / 3 << " triangles" << endl;
+		cout << "\tconvert 1 thread  : " << serialMs << " ms" << endl;
+		cout << "\tconvert " << pool.size() << " threads : " << parallelMs << " ms (x" << serialMs / parallelMs << ")" << endl;
+	}
+
+	/*
+	main runs this instead of the app for --import-rss <glb|assimp> <path> : one import in a process that has not
+	touched Vulkan or the model yet, so the peak rss growth is that importer's alone, Assimp's own allocations included.
+	*/
+	int importPeakRss(const std::string& importer, const std::string& path) {
+
+		using std::cout; using std::endl;
+		ThreadPool pool;
+		std::vector<Vertex> benchVertices;
+		std::vector<uint32_t> benchIndices;
+		std::vector<MeshRange> benchRanges;
+		std::vector<Material> benchMaterials;
+		std::vector<MeshInstance> benchInstances;
+
+		const uint64_t baseline = peakResidentBytes();
+		if (importer == "glb") {
+			loadGLBModel(path, benchVertices, benchIndices, benchRanges, benchMaterials, benchInstances, &pool);
+		}
+		else if (importer == "assimp") {
+			Assimp::Importer assimpImporter;
+			const aiScene* scene = assimpImporter.ReadFile(path, MODEL_IMPORT_FLAGS);
+			if (!scene) {
+				std::cerr << "Assimp Error: " << assimpImporter.GetErrorString() << std::endl;
+				return EXIT_FAILURE;
+			}
+			convertSceneMeshes(scene, benchVertices, benchIndices, benchRanges, &pool);
+			collectSceneInstances(scene, benchInstances);
+		}
+		else {
+			std::cerr << "--import-rss : unknown importer " << importer << std::endl;
+			return EXIT_FAILURE;
+		}
+
+		const double mb = 1.0 / (1024.0 * 1024.0);
+		cout << "\t" << (importer == "glb" ? "native glb    " : "assimp+convert") << "  : peak rss +" << (peakResidentBytes() - baseline) * mb
+			<< " MB (" << benchIndices.size() / 3 << " triangles)" << endl;
+		return EXIT_SUCCESS;
+	}
+
+	/*
+	native reader against Assimp + convert on the same file, both end in the same flat arrays.
+	Timed in this process, the memory side starts each importer in its own process (importPeakRss) since
+	loadModel has already set this process's peak.
+	*/
+	void benchmarkGLBImport(const std::string& path, ThreadPool& pool) {
+
+		using std::cout; using std::endl;
+		std::vector<Vertex> benchVertices;
+		std::vector<uint32_t> benchIndices;
+		std::vector<MeshRange> benchRanges;
+		std::vector<Material> benchMaterials;
+		std::vector<MeshInstance> benchInstances;
+
+		auto resetArrays = [&] {
+			std::vector<Vertex>().swap(benchVertices);
+			std::vector<uint32_t>().swap(benchIndices);
+		};
+
+		double glbMs = bestOfRuns([&] {
+			resetArrays();
+			loadGLBModel(path, benchVertices, benchIndices, benchRanges, benchMaterials, benchInstances, &pool);
+		});
+		size_t glbTriangles = benchIndices.size() / 3;
+		resetArrays();
+
+		double assimpMs = bestOfRuns([&] {
+			resetArrays();
+			Assimp::Importer importer;
+			const aiScene* scene = importer.ReadFile(path, MODEL_IMPORT_FLAGS);
+			if (!scene) return;
+			convertSceneMeshes(scene, benchVertices, benchIndices, benchRanges, &pool);
+			collectSceneInstances(scene, benchInstances);
+		});
+
+		cout << path << " : glb " << glbTriangles << " triangles, assimp " << benchIndices.size() / 3 << " triangles" << endl;
+		cout << "\tnative glb      : " << glbMs << " ms" << endl;
+		cout << "\tassimp+convert  : " << assimpMs << " ms (x" << assimpMs / glbMs << ")" << endl;
+
+		if (benchmarkExecutable.empty()) return;
+		cout.flush();
+		for (const char* importer : { "glb", "assimp" }) {
+			const std::string command = "\"" + benchmarkExecutable + "\" --import-rss " + importer + " \"" + path + "\"";
+			if (std::system(command.c_str()) != 0) std::cerr << "import rss run failed : " << command << std::endl;
+		}
+	}
+
+	void MainVulkApplication::benchmarkModelImport() {
+
+		using std::cout; using std::endl;
+		if (!workerPool) workerPool = std::make_unique<ThreadPool>();
+
+		cout << "---- import benchmark ----" << endl;
+		if (hasExtension(MODEL_PATH, ".glb")) {
+			try { benchmarkGLBImport(MODEL_PATH, *workerPool); }
+			catch (const std::exception& e) { std::cerr << e.what() << std::endl; }
+		}
+		{
+			Assimp::Importer importer;
+			const aiScene* scene = nullptr;
+			double readMs = bestOfRuns([&] {
+				importer.FreeScene();
+				scene = importer.ReadFile(MODEL_PATH, MODEL_IMPORT_FLAGS);
+			});
+			if (!scene) {
+				std::cerr << "Assimp Error: " << importer.GetErrorString() << std::endl;
+				return;
+			}
+			cout << MODEL_PATH << " ReadFile : " << readMs << " ms" << endl;
+			printConvertTiming(MODEL_PATH.c_str(), scene, *workerPool);
+		}
+		{
+			// 2238^2 grid -> 10,008,338 triangles
+			auto buildStart = std::chrono::high_resolution_clock::now();
+			std::unique_ptr<aiScene> synthetic = makeSyntheticScene(2238);
+			cout << "synthetic scene built in " << elapsedMs(buildStart, std::chrono::high_resolution_clock::now()) << " ms" << endl;
+			printConvertTiming("synthetic grid", synthetic.get(), *workerPool);
+		}
+	}
+
+	// distinct cache lines touched reading the 12 position bytes of every vertex, a lower bound for the build's vertex traffic
+	uint64_t positionCacheLines(size_t vertexCount, size_t stride, size_t offset) {
+		constexpr size_t LINE = 64;
+		uint64_t lines = 0;
+		size_t lastLine = SIZE_MAX;
+		for (size_t v = 0; v < vertexCount; ++v) {
+			size_t first = (v * stride + offset) / LINE;
+			size_t last = (v * stride + offset + sizeof(glm::vec3) - 1) / LINE;
+			lines += last - first + 1 - (first == lastLine ? 1 : 0);
+			lastLine = last;
+		}
+		return lines;
+	}
+
+	// the same whole scene BLAS built from the interleaved vertices and from the packed position stream, timed on the gpu
+	void MainVulkApplication::benchmarkBLASInputLayouts() {
+
+		using std::cout; using std::endl;
+		cout << "---- BLAS input benchmark ----" << endl;
+		if (vertexLayout != VertexLayout::Full || geometry.indexCount == 0) {
+			cout << "needs the full vertex layout, skipped" << endl;
+			return;
+		}
+
+		// geometry is still on the cpu here, whichever of the two streams the scene was loaded without is made temporarily
+		const bool temporaryPositions = positionBuffer == VK_NULL_HANDLE;
+		VkBuffer interleavedBuffer = vertexBuffer;
+		MemoryAllocation interleavedBufferMemory;
+		if (temporaryPositions) createPositionBuffer();
+		else {
+			interleavedBuffer = VK_NULL_HANDLE;
+			uploadBuffer(sizeof(Vertex) * geometry.vertexCount, RT_GEOMETRY_BUFFER_USAGE, interleavedBuffer, interleavedBufferMemory, MemoryCategory::Vertex,
+				[&](void* data) {
+					memcpy(data, geometry.vertices, sizeof(Vertex) * geometry.vertexCount);
+				});
+		}
+
+		VkPhysicalDeviceProperties deviceProperties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+
+		VkQueryPoolCreateInfo queryPoolInfo{};
+		queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolInfo.queryCount = 2;
+		VkQueryPool queryPool;
+		check_vk_result(vkCreateQueryPool(device, &queryPoolInfo, nullptr, &queryPool));
+
+		const uint32_t primitiveCount = sceneIndexCount() / 3;
+
+		auto timeBuild = [&](VkBuffer source, VkDeviceSize stride, VkDeviceSize& asSize) {
+			VkAccelerationStructureGeometryKHR triangleGeometry{};
+			triangleGeometry.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
+			triangleGeometry.geometryType = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
+			triangleGeometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
+			triangleGeometry.geometry.triangles.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR;
+			triangleGeometry.geometry.triangles.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT;
+			triangleGeometry.geometry.triangles.vertexData.deviceAddress = GetBufferDeviceAddress(source) + (source == interleavedBuffer ? offsetof(Vertex, pos) : 0);
+			triangleGeometry.geometry.triangles.vertexStride = stride;
+			triangleGeometry.geometry.triangles.maxVertex = static_cast<uint32_t>(geometry.vertexCount - 1);
+			triangleGeometry.geometry.triangles.indexType = VK_INDEX_TYPE_UINT32;
+			triangleGeometry.geometry.triangles.indexData.deviceAddress = GetBufferDeviceAddress(indexBuffer);
+
+			VkAccelerationStructureBuildGeometryInfoKHR buildInfo{};
+			buildInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
+			buildInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+			buildInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+			buildInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+			buildInfo.geometryCount = 1;
+			buildInfo.pGeometries = &triangleGeometry;
+
+			VkAccelerationStructureBuildSizesInfoKHR sizeInfo{};
+			sizeInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
+			vkGetAccelerationStructureBuildSizesKHR(device, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &buildInfo, &primitiveCount, &sizeInfo);
+			asSize = sizeInfo.accelerationStructureSize;
+
+			double best = std::numeric_limits<double>::max();
+			for (int run = 0; run < BENCHMARK_RUNS; ++run) {
+				AccelerationStructure blas{};
+				createAccelerationStructure(blas, VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, sizeInfo);
+				resetScratch(scratchFootprint(sizeInfo.buildScratchSize));
+				buildInfo.dstAccelerationStructure = blas.handle;
+				buildInfo.scratchData.deviceAddress = allocateScratch(sizeInfo.buildScratchSize);
+
+				VkAccelerationStructureBuildRangeInfoKHR rangeInfo{};
+				rangeInfo.primitiveCount = primitiveCount;
+				const VkAccelerationStructureBuildRangeInfoKHR* rangeInfos[] = { &rangeInfo };
+
+				VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+				vkCmdResetQueryPool(commandBuffer, queryPool, 0, 2);
+				vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+				vkCmdBuildAccelerationStructuresKHR(commandBuffer, 1, &buildInfo, rangeInfos);
+				vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, queryPool, 1);
+				endSingleTimeCommands(commandBuffer);
+
+				uint64_t timestamps[2] = {};
+				check_vk_result(vkGetQueryPoolResults(device, queryPool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t),
+					VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+				best = std::min(best, double(timestamps[1] - timestamps[0]) * deviceProperties.limits.timestampPeriod * 1e-6);
+
+				destroyAccelerationStructure(blas);
+			}
+			return best;
+		};
+
+		VkDeviceSize interleavedSize = 0, packedSize = 0;
+		double interleavedMs = timeBuild(interleavedBuffer, sizeof(Vertex), interleavedSize);
+		double packedMs = timeBuild(positionBuffer, sizeof(glm::vec3), packedSize);
+
+		const double mb = 1.0 / (1024.0 * 1024.0);
+		auto report = [&](const char* label, double ms, size_t stride, size_t offset, VkDeviceSize asSize) {
+			cout << label << ms << " ms, vertex span " << geometry.vertexCount * stride * mb << " MB, position lines "
+				<< positionCacheLines(geometry.vertexCount, stride, offset) * 64 * mb << " MB, BLAS " << asSize * mb << " MB" << endl;
+		};
+		cout << geometry.vertexCount << " vertices, " << primitiveCount << " triangles" << endl;
+		report("\tinterleaved : ", interleavedMs, sizeof(Vertex), offsetof(Vertex, pos), interleavedSize);
+		report("\tpositions   : ", packedMs, sizeof(glm::vec3), 0, packedSize);
+		cout << "\tspeedup     : x" << interleavedMs / packedMs << endl;
+
+		vkDestroyQueryPool(device, queryPool, nullptr);
+		if (temporaryPositions) {
+			destroyBuffer(positionBuffer, positionBufferMemory);
+		}
+		else destroyBuffer(interleavedBuffer, interleavedBufferMemory);
+	}
+
+	// rays per policy, from the centre of the scene bounds over the whole sphere
+	constexpr uint32_t POLICY_TRACE_WIDTH = 1024;
+	constexpr uint32_t POLICY_TRACE_HEIGHT = 512;
+
+	struct PolicyTraceConstants {
+		glm::vec4 origin;  // xyz, w = ray length
+		uint32_t width;
+		uint32_t height;
+	};
+
+	/*
+	Build time against trace time of the scene's level 0 BLAS under every build policy, timed on the gpu.
+	Per policy: all BLAS in one batched build, a refit of all of them when the policy allows updates, the compacted
+	size when it compacts, then a TLAS over the scene instances and POLICY_TRACE_WIDTH x POLICY_TRACE_HEIGHT closest
+	hit ray queries from shaders/AS_policy_trace.comp. Tracing needs VK_KHR_ray_query and the compiled shader,
+	without them only the build side is reported. The scene's own BLAS are left alone.
+	*/
+	void MainVulkApplication::benchmarkASBuildPolicies() {
+
+		using std::cout; using std::endl;
+		cout << "---- AS build policy benchmark ----" << endl;
+		if (scene.objects.empty() || scene.instances.empty()) {
+			cout << "no scene objects, skipped" << endl;
+			return;
+		}
+
+		VkPhysicalDeviceProperties deviceProperties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+
+		VkQueryPoolCreateInfo queryPoolInfo{};
+		queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolInfo.queryCount = 2;
+		VkQueryPool timestamps;
+		check_vk_result(vkCreateQueryPool(device, &queryPoolInfo, nullptr, &timestamps));
+		auto elapsedGpuMs = [&]() {
+			uint64_t ticks[2] = {};
+			check_vk_result(vkGetQueryPoolResults(device, timestamps, 0, 2, sizeof(ticks), ticks, sizeof(uint64_t),
+				VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+			return double(ticks[1] - ticks[0]) * deviceProperties.limits.timestampPeriod * 1e-6;
+		};
+
+		// world bounds of every placement, the rays start in the middle and reach past the far side
+		glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+		for (const SceneInstance& instance : scene.instances) {
+			const SceneObject& object = scene.objects.at(instance.objectId);
+			const glm::mat4 world = instanceWorld(instance);
+			const glm::vec3 center = glm::vec3(world * glm::vec4(object.boundsCenter, 1.0f));
+			const float scale = std::max({ glm::length(glm::vec3(world[0])), glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2])) });
+			boundsMin = glm::min(boundsMin, center - glm::vec3(object.boundsRadius * scale));
+			boundsMax = glm::max(boundsMax, center + glm::vec3(object.boundsRadius * scale));
+		}
+		PolicyTraceConstants traceConstants{};
+		traceConstants.origin = glm::vec4((boundsMin + boundsMax) * 0.5f, glm::length(boundsMax - boundsMin) + 1.0f);
+		traceConstants.width = POLICY_TRACE_WIDTH;
+		traceConstants.height = POLICY_TRACE_HEIGHT;
+
+		std::vector<char> traceCode;
+		if (rayQuerySupported) {
+			try { traceCode = readFile("shaders/AS_policy_trace.spv"); }
+			catch (const std::exception&) {}
+		}
+		if (traceCode.empty())
+			cout << (rayQuerySupported ? "shaders/AS_policy_trace.spv missing" : "VK_KHR_ray_query not supported") << ", build side only" << endl;
+
+		VkDescriptorSetLayout traceSetLayout = VK_NULL_HANDLE;
+		VkDescriptorPool tracePool = VK_NULL_HANDLE;
+		VkDescriptorSet traceSet = VK_NULL_HANDLE;
+		VkPipelineLayout tracePipelineLayout = VK_NULL_HANDLE;
+		VkPipeline tracePipeline = VK_NULL_HANDLE;
+		VkBuffer hitBuffer = VK_NULL_HANDLE;
+		MemoryAllocation hitBufferMemory;
+		if (!traceCode.empty()) {
+			VkDescriptorSetLayoutBinding bindings[2]{};
+			bindings[0].binding = 0;
+			bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+			bindings[0].descriptorCount = 1;
+			bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			bindings[1].binding = 1;
+			bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[1].descriptorCount = 1;
+			bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			VkDescriptorSetLayoutCreateInfo layoutInfo{};
+			layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+			layoutInfo.bindingCount = 2;
+			layoutInfo.pBindings = bindings;
+			check_vk_result(vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &traceSetLayout));
+
+			VkDescriptorPoolSize poolSizes[2] = { { VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, 1 }, { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1 } };
+			VkDescriptorPoolCreateInfo poolInfo{};
+			poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+			poolInfo.maxSets = 1;
+			poolInfo.poolSizeCount = 2;
+			poolInfo.pPoolSizes = poolSizes;
+			check_vk_result(vkCreateDescriptorPool(device, &poolInfo, nullptr, &tracePool));
+
+			VkDescriptorSetAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+			allocInfo.descriptorPool = tracePool;
+			allocInfo.descriptorSetCount = 1;
+			allocInfo.pSetLayouts = &traceSetLayout;
+			check_vk_result(vkAllocateDescriptorSets(device, &allocInfo, &traceSet));
+
+			VkPushConstantRange pushRange{ VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PolicyTraceConstants) };
+			VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+			pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+			pipelineLayoutInfo.setLayoutCount = 1;
+			pipelineLayoutInfo.pSetLayouts = &traceSetLayout;
+			pipelineLayoutInfo.pushConstantRangeCount = 1;
+			pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+			check_vk_result(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &tracePipelineLayout));
+
+			VkShaderModule module = createShaderModule(traceCode);
+			VkComputePipelineCreateInfo pipelineInfo{};
+			pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+			pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+			pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+			pipelineInfo.stage.module = module;
+			pipelineInfo.stage.pName = "main";
+			pipelineInfo.layout = tracePipelineLayout;
+			check_vk_result(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &tracePipeline));
+			vkDestroyShaderModule(device, module, nullptr);
+
+			const VkDeviceSize hitBytes = sizeof(float) * POLICY_TRACE_WIDTH * POLICY_TRACE_HEIGHT;
+			createBuffer(hitBytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				hitBuffer, hitBufferMemory, false, MemoryCategory::Other);
+			VkDescriptorBufferInfo hitInfo{ hitBuffer, 0, hitBytes };
+			VkWriteDescriptorSet write{};
+			write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			write.dstSet = traceSet;
+			write.dstBinding = 1;
+			write.descriptorCount = 1;
+			write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			write.pBufferInfo = &hitInfo;
+			vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+		}
+
+		const uint32_t instanceCount = static_cast<uint32_t>(scene.instances.size());
+		VkBuffer instanceBuffer = VK_NULL_HANDLE;
+		MemoryAllocation instanceBufferMemory;
+		createBuffer(sizeof(VkAccelerationStructureInstanceKHR) * instanceCount,
+			VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			instanceBuffer, instanceBufferMemory, true, MemoryCategory::TLAS);
+
+		size_t triangles = 0;
+		for (const auto& entry : scene.objects) triangles += entry.second.lods[0].indexCount / 3;
+		cout << scene.objects.size() << " BLAS, " << triangles << " triangles, " << instanceCount << " instances, "
+			<< POLICY_TRACE_WIDTH * POLICY_TRACE_HEIGHT << " rays" << endl;
+
+		const double mb = 1.0 / (1024.0 * 1024.0);
+		const AsBuildPolicy policies[] = { AsBuildPolicy::FastTrace, AsBuildPolicy::FastTraceCompact, AsBuildPolicy::FastTraceUpdate,
+			AsBuildPolicy::FastBuild, AsBuildPolicy::FastBuildUpdate };
+		for (AsBuildPolicy policy : policies) {
+			// copies of level 0, node based so the pointers below stay put
+			std::unordered_map<uint64_t, LodLevel> levels;
+			std::vector<BlasBuild> builds;
+			std::vector<LodLevel*> compactable;
+			builds.reserve(scene.objects.size());
+			for (const auto& entry : scene.objects) {
+				LodLevel& level = levels[entry.first];
+				level = entry.second.lods[0];
+				level.blas = AccelerationStructure{};
+				builds.emplace_back();
+				prepareBLAS(entry.second, level, builds.back(), policy);
+				if (builds.back().buildInfo.flags & VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR) compactable.push_back(&level);
+			}
+
+			VkQueryPool compactedSizes = VK_NULL_HANDLE;
+			if (!compactable.empty()) {
+				VkQueryPoolCreateInfo compactedInfo{};
+				compactedInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+				compactedInfo.queryType = VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR;
+				compactedInfo.queryCount = static_cast<uint32_t>(compactable.size());
+				check_vk_result(vkCreateQueryPool(device, &compactedInfo, nullptr, &compactedSizes));
+			}
+
+			// rebuilding into the same structures, the first run pays for nothing the others do not
+			double buildMs = std::numeric_limits<double>::max();
+			for (int run = 0; run < BENCHMARK_RUNS; ++run) {
+				buildBLASBatches(builds, compactedSizes, timestamps);
+				buildMs = std::min(buildMs, elapsedGpuMs());
+			}
+
+			double refitMs = 0.0;
+			if (asBuildRefits(policy)) {
+				refitMs = std::numeric_limits<double>::max();
+				for (BlasBuild& build : builds) {
+					build.buildInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR;
+					build.buildInfo.srcAccelerationStructure = build.buildInfo.dstAccelerationStructure;
+					build.scratchSize = build.updateScratchSize;
+				}
+				for (int run = 0; run < BENCHMARK_RUNS; ++run) {
+					buildBLASBatches(builds, VK_NULL_HANDLE, timestamps);
+					refitMs = std::min(refitMs, elapsedGpuMs());
+				}
+			}
+
+			if (compactedSizes != VK_NULL_HANDLE) {
+				compactBLAS(compactable, compactedSizes);
+				vkDestroyQueryPool(device, compactedSizes, nullptr);
+			}
+			VkDeviceSize blasBytes = 0;
+			for (const auto& entry : levels) blasBytes += entry.second.blas.size;
+
+			VkAccelerationStructureInstanceKHR* instances = static_cast<VkAccelerationStructureInstanceKHR*>(instanceBufferMemory.mapped);
+			for (uint32_t i = 0; i < instanceCount; ++i) {
+				const SceneInstance& sceneInstance = scene.instances[i];
+				VkAccelerationStructureInstanceKHR instance = {};
+				const glm::mat4 rows = glm::transpose(instanceWorld(sceneInstance));
+				memcpy(&instance.transform, &rows, sizeof(VkTransformMatrixKHR));
+				instance.mask = 0xFF;
+				instance.flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
+				instance.accelerationStructureReference = levels.at(sceneInstance.objectId).blas.deviceAddress;
+				instances[i] = instance;
+			}
+
+			VkAccelerationStructureGeometryKHR tlasGeometry{};
+			tlasGeometry.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
+			tlasGeometry.geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR;
+			tlasGeometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
+			tlasGeometry.geometry.instances.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR;
+			tlasGeometry.geometry.instances.data.deviceAddress = GetBufferDeviceAddress(instanceBuffer);
+
+			VkAccelerationStructureBuildGeometryInfoKHR tlasBuildInfo{};
+			tlasBuildInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
+			tlasBuildInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
+			tlasBuildInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+			tlasBuildInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+			tlasBuildInfo.geometryCount = 1;
+			tlasBuildInfo.pGeometries = &tlasGeometry;
+
+			VkAccelerationStructureBuildSizesInfoKHR sizeInfo{};
+			sizeInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
+			vkGetAccelerationStructureBuildSizesKHR(device, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &tlasBuildInfo, &instanceCount, &sizeInfo);
+			AccelerationStructure tlas{};
+			createAccelerationStructure(tlas, VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR, sizeInfo);
+			resetScratch(scratchFootprint(sizeInfo.buildScratchSize));
+			tlasBuildInfo.dstAccelerationStructure = tlas.handle;
+			tlasBuildInfo.scratchData.deviceAddress = allocateScratch(sizeInfo.buildScratchSize);
+
+			VkAccelerationStructureBuildRangeInfoKHR rangeInfo{};
+			rangeInfo.primitiveCount = instanceCount;
+			const VkAccelerationStructureBuildRangeInfoKHR* rangeInfos[] = { &rangeInfo };
+			VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+			vkCmdBuildAccelerationStructuresKHR(commandBuffer, 1, &tlasBuildInfo, rangeInfos);
+			// the ray queries read it from the compute stage
+			VkMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+			barrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				0, 1, &barrier, 0, nullptr, 0, nullptr);
+			endSingleTimeCommands(commandBuffer);
+
+			double traceMs = 0.0;
+			if (tracePipeline != VK_NULL_HANDLE) {
+				VkWriteDescriptorSetAccelerationStructureKHR asInfo{};
+				asInfo.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_ACCELERATION_STRUCTURE_KHR;
+				asInfo.accelerationStructureCount = 1;
+				asInfo.pAccelerationStructures = &tlas.handle;
+				VkWriteDescriptorSet write{};
+				write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				write.pNext = &asInfo;
+				write.dstSet = traceSet;
+				write.dstBinding = 0;
+				write.descriptorCount = 1;
+				write.descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+				vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+
+				traceMs = std::numeric_limits<double>::max();
+				for (int run = 0; run < BENCHMARK_RUNS; ++run) {
+					commandBuffer = beginSingleTimeCommands();
+					vkCmdResetQueryPool(commandBuffer, timestamps, 0, 2);
+					vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, tracePipeline);
+					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, tracePipelineLayout, 0, 1, &traceSet, 0, nullptr);
+					vkCmdPushConstants(commandBuffer, tracePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(traceConstants), &traceConstants);
+					vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestamps, 0);
+					vkCmdDispatch(commandBuffer, (POLICY_TRACE_WIDTH + 7) / 8, (POLICY_TRACE_HEIGHT + 7) / 8, 1);
+					vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, timestamps, 1);
+					endSingleTimeCommands(commandBuffer);
+					traceMs = std::min(traceMs, elapsedGpuMs());
+				}
+			}
+
+			cout << "\t" << asBuildPolicyName(policy) << " : build " << buildMs << " ms";
+			if (asBuildRefits(policy)) cout << ", refit " << refitMs << " ms";
+			cout << ", BLAS " << blasBytes * mb << " MB";
+			if (tracePipeline != VK_NULL_HANDLE)
+				cout << ", trace " << traceMs << " ms (" << POLICY_TRACE_WIDTH * POLICY_TRACE_HEIGHT / (traceMs * 1000.0) << " Mrays/s)";
+			cout << endl;
+
+			destroyAccelerationStructure(tlas);
+			for (auto& entry : levels) destroyAccelerationStructure(entry.second.blas);
+		}
+
+		destroyBuffer(instanceBuffer, instanceBufferMemory);
+		if (tracePipeline != VK_NULL_HANDLE) {
+			destroyBuffer(hitBuffer, hitBufferMemory);
+			vkDestroyPipeline(device, tracePipeline, nullptr);
+			vkDestroyPipelineLayout(device, tracePipelineLayout, nullptr);
+			vkDestroyDescriptorPool(device, tracePool, nullptr);
+			vkDestroyDescriptorSetLayout(device, traceSetLayout, nullptr);
+		}
+		vkDestroyQueryPool(device, timestamps, nullptr);
+	}
+
+	/*
+	Level 0 of every object built with fast trace flags on the queue, then on the cpu with vkBuildAccelerationStructuresKHR
+	by one thread and by every thread the deferred operation takes. The host side is wall clock, so on a cpu
+	implementation such as lavapipe all three are cpu time and the runs compare the build on machines without a gpu.
+	*/
+	void MainVulkApplication::benchmarkHostASBuilds() {
+
+		using std::cout; using std::endl;
+		cout << "---- host AS build benchmark ----" << endl;
+		if (!hostBuildSupported) {
+			cout << "accelerationStructureHostCommands not supported, skipped" << endl;
+			return;
+		}
+		if (scene.objects.empty() || !geometry.vertices || !geometry.indices) {
+			cout << "no scene geometry on the cpu, skipped" << endl;
+			return;
+		}
+		if (!workerPool) workerPool = std::make_unique<ThreadPool>();
+
+		VkPhysicalDeviceProperties deviceProperties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+
+		VkQueryPoolCreateInfo queryPoolInfo{};
+		queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolInfo.queryCount = 2;
+		VkQueryPool timestamps;
+		check_vk_result(vkCreateQueryPool(device, &queryPoolInfo, nullptr, &timestamps));
+
+		// best of the runs, rebuilding into the same structures, joined reports the threads of the last host run
+		auto timeBuilds = [&](bool host, uint32_t threads, uint32_t& joined) {
+			std::unordered_map<uint64_t, LodLevel> levels;
+			std::vector<BlasBuild> builds;
+			builds.reserve(scene.objects.size());
+			for (const auto& entry : scene.objects) {
+				LodLevel& level = levels[entry.first];
+				level = entry.second.lods[0];
+				level.blas = AccelerationStructure{};
+				builds.emplace_back();
+				prepareBLAS(entry.second, level, builds.back(), AsBuildPolicy::FastTrace, host);
+			}
+
+			double best = std::numeric_limits<double>::max();
+			for (int run = 0; run < BENCHMARK_RUNS; ++run) {
+				if (host) {
+					auto start = std::chrono::high_resolution_clock::now();
+					joined = buildBLASHost(builds, threads);
+					best = std::min(best, elapsedMs(start, std::chrono::high_resolution_clock::now()));
+				}
+				else {
+					buildBLASBatches(builds, VK_NULL_HANDLE, timestamps);
+					uint64_t ticks[2] = {};
+					check_vk_result(vkGetQueryPoolResults(device, timestamps, 0, 2, sizeof(ticks), ticks, sizeof(uint64_t),
+						VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+					best = std::min(best, double(ticks[1] - ticks[0]) * deviceProperties.limits.timestampPeriod * 1e-6);
+				}
+			}
+			for (auto& entry : levels) destroyAccelerationStructure(entry.second.blas);
+			return best;
+		};
+
+		size_t triangles = 0;
+		for (const auto& entry : scene.objects) triangles += entry.second.lods[0].indexCount / 3;
+		cout << scene.objects.size() << " BLAS, " << triangles << " triangles, " << workerPool->size() + 1 << " cpu threads" << endl;
+
+		uint32_t joined = 0;
+		const double deviceMs = timeBuilds(false, 0, joined);
+		const double singleMs = timeBuilds(true, 1, joined);
+		const double parallelMs = timeBuilds(true, 0, joined);
+		cout << "\tqueue            : " << deviceMs << " ms" << endl;
+		cout << "\thost, 1 thread   : " << singleMs << " ms" << endl;
+		cout << "\thost, " << joined << " threads : " << parallelMs << " ms (x" << singleMs / parallelMs << ")" << endl;
+
+		vkDestroyQueryPool(device, timestamps, nullptr);
+	}
+}
+
+#endif
@@ -0,0 +1,248 @@
+#ifndef __VK_DEFRAG_HPP__
+#define __VK_DEFRAG_HPP__
+
+/*
+Incremental defragmentation of the device local pools, one pass per frame at most defragBytesPerFrame.
+
+	memoryManager.planMove picks the target, out of a pool's emptiest block or lower inside the same block
+	buffers are copied with vkCmdCopyBuffer, acceleration structures cloned with vkCmdCopyAccelerationStructureKHR
+	the owner's handle / allocation / device address are swapped right after recording, the old side is kept until the pass's fence
+
+Dependents that are patched:
+	BLAS moved        -> tlasDirty, createTLAS rewrites the instances with the new references this frame
+	TLAS moved        -> writeTlasDescriptor, after a queue idle since the sets of frames in flight name the old handle
+	geometry moved    -> after the same queue idle, refreshGeometryConsumers
+
+Every consumer of a relocatable geometry buffer (vertex, index, position, meshInfo), keep this list complete:
+	commandBuffers (createCommandBuffers)   binds vertex + position as vertex buffers and index, recorded once -> re-recorded
+	SceneObject::vertexBuffer / indexBuffer cached handle and descriptor info (buildSceneObjects) -> rewritten
+	prepareBLAS / updateObjectBLAS          read the device addresses at build time, built BLAS do not reference their input
+	meshInfoBuffer                          no descriptor names it yet, hit shaders will take it through the geometry set
+No descriptor set is written with any of them today, one that is has to be rewritten in refreshGeometryConsumers.
+
+The pass is submitted before the frame on the same queue, and the fence covers everything submitted earlier, so once it
+signals no frame can still read the old copies. Host visible pools are left alone, their mapped pointers live elsewhere.
+*/
+
+namespace VkApplication {
+
+	void MainVulkApplication::defragmentStep() {
+		if (!defragEnabled) return;
+		if (defragInFlight) {
+			if (vkGetFenceStatus(device, defragFence) != VK_SUCCESS) return;
+			retireDefrag();
+		}
+
+		// nothing was allocated or freed since a scan came back empty, it would come back empty again
+		const MemoryPoolStats poolStats = memoryManager.getStats();
+		const uint64_t generation = poolStats.allocations + poolStats.frees;
+		if (generation == defragIdleAt) return;
+
+		VkDeviceSize moved = 0;
+		bool tlasMoved = false;
+		bool geometryMoved = false;
+		// the first move always goes, a buffer larger than the budget would otherwise never leave its block
+		auto fits = [&](const MemoryAllocation& memory) {
+			return memory.pool != UINT32_MAX && (moved == 0 || moved + memory.size <= defragBytesPerFrame);
+		};
+
+		for (auto buffer : { std::make_pair(&vertexBuffer, &vertexBufferMemory), std::make_pair(&indexBuffer, &indexBufferMemory),
+			std::make_pair(&positionBuffer, &positionBufferMemory), std::make_pair(&meshInfoBuffer, &meshInfoBufferMemory) }) {
+			const VkDeviceSize size = buffer.second->size;
+			if (fits(*buffer.second) && relocateBuffer(*buffer.first, *buffer.second)) {
+				moved += size;
+				geometryMoved = true;
+			}
+		}
+
+		for (auto& entry : scene.objects) {
+			SceneObject& object = entry.second;
+			for (LodLevel& level : object.lods) {
+				const VkDeviceSize size = level.blas.memory.size;
+				if (!fits(level.blas.memory) || !relocateAccelerationStructure(level.blas)) continue;
+				moved += size;
+				tlasDirty = true;
+			}
+			if (!object.lods.empty()) object.blas = object.lods[0].blas;
+		}
+
+		const VkDeviceSize tlasSize = topLevelAS.memory.size;
+		if (fits(topLevelAS.memory) && relocateAccelerationStructure(topLevelAS)) {
+			moved += tlasSize;
+			tlasMoved = true;
+		}
+
+		if (moved == 0) {
+			defragIdleAt = generation;
+			return;
+		}
+
+		// the new copies are visible to the TLAS build and the traces submitted after this pass
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+		barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+		vkCmdPipelineBarrier(defragCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+			VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+		check_vk_result(vkEndCommandBuffer(defragCommandBuffer));
+
+		if (defragFence == VK_NULL_HANDLE) {
+			VkFenceCreateInfo fenceInfo{};
+			fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+			check_vk_result(vkCreateFence(device, &fenceInfo, nullptr, &defragFence));
+		}
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &defragCommandBuffer;
+		check_vk_result(vkQueueSubmit(graphicsQueue, 1, &submitInfo, defragFence));
+		defragInFlight = true;
+		defragStats.passes++;
+
+		// frames in flight were recorded against the old handles, the fence of the pass would not cover frames
+		// submitted after it, so the consumers are switched once the queue is idle, before this frame records
+		if (tlasMoved || geometryMoved) {
+			vkQueueWaitIdle(graphicsQueue);
+			if (tlasMoved) writeTlasDescriptor();
+			if (geometryMoved) refreshGeometryConsumers();
+			defragStats.stalls++;
+		}
+	}
+
+	// points everything listed at the top of this file at the current geometry buffers, the queue must be idle
+	void MainVulkApplication::refreshGeometryConsumers() {
+		for (auto& entry : scene.objects) {
+			SceneObject& object = entry.second;
+			if (object.vertexBuffer.buffer != VK_NULL_HANDLE) {
+				object.vertexBuffer.buffer = vertexBuffer;
+				object.vertexBuffer.setupDescriptor(object.vertexBuffer.descriptor.range, object.vertexBuffer.descriptor.offset);
+			}
+			if (object.indexBuffer.buffer != VK_NULL_HANDLE) {
+				object.indexBuffer.buffer = indexBuffer;
+				object.indexBuffer.setupDescriptor(object.indexBuffer.descriptor.range, object.indexBuffer.descriptor.offset);
+			}
+		}
+
+		if (!commandBuffers.empty()) {
+			vkFreeCommandBuffers(device, commandPool, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
+			createCommandBuffers();
+		}
+	}
+
+	// destroys the old side of every move of the submitted pass, waits for its fence
+	void MainVulkApplication::retireDefrag() {
+		if (!defragInFlight) return;
+		check_vk_result(vkWaitForFences(device, 1, &defragFence, VK_TRUE, UINT64_MAX));
+
+		for (DefragRetired& retired : defragRetired) {
+			if (retired.accelerationStructure != VK_NULL_HANDLE)
+				vkDestroyAccelerationStructureKHR(device, retired.accelerationStructure, nullptr);
+			destroyBuffer(retired.buffer, retired.memory);
+		}
+		defragRetired.clear();
+
+		check_vk_result(vkResetFences(device, 1, &defragFence));
+		vkFreeCommandBuffers(device, commandPool, 1, &defragCommandBuffer);
+		defragCommandBuffer = VK_NULL_HANDLE;
+		defragInFlight = false;
+	}
+
+	void MainVulkApplication::destroyDefrag() {
+		retireDefrag();
+		if (defragFence != VK_NULL_HANDLE) vkDestroyFence(device, defragFence, nullptr);
+		defragFence = VK_NULL_HANDLE;
+	}
+
+	// buffer like the one bound at src, bound at the planned target, VK_NULL_HANDLE when src should stay
+	VkBuffer MainVulkApplication::createRelocatedBuffer(const MemoryAllocation& src, MemoryAllocation& target) {
+		if (src.bufferSize == 0 || !memoryManager.planMove(src, target)) return VK_NULL_HANDLE;
+
+		VkBufferCreateInfo bufferInfo{};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = src.bufferSize;
+		bufferInfo.usage = src.usage;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		VkBuffer buffer;
+		check_vk_result(vkCreateBuffer(device, &bufferInfo, nullptr, &buffer));
+
+		VkMemoryRequirements memRequirements;
+		vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+		if (memRequirements.size > target.size || target.offset % memRequirements.alignment != 0) {
+			vkDestroyBuffer(device, buffer, nullptr);
+			memoryManager.free(target);
+			return VK_NULL_HANDLE;
+		}
+		check_vk_result(vkBindBufferMemory(device, buffer, target.memory, target.offset));
+
+		if (defragCommandBuffer == VK_NULL_HANDLE) {
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			allocInfo.commandPool = commandPool;
+			allocInfo.commandBufferCount = 1;
+			check_vk_result(vkAllocateCommandBuffers(device, &allocInfo, &defragCommandBuffer));
+
+			VkCommandBufferBeginInfo beginInfo{};
+			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			check_vk_result(vkBeginCommandBuffer(defragCommandBuffer, &beginInfo));
+		}
+
+		defragStats.moves++;
+		defragStats.movedBytes += src.size;
+		return buffer;
+	}
+
+	bool MainVulkApplication::relocateBuffer(VkBuffer& buffer, MemoryAllocation& memory) {
+		if (buffer == VK_NULL_HANDLE) return false;
+		MemoryAllocation target;
+		VkBuffer moved = createRelocatedBuffer(memory, target);
+		if (moved == VK_NULL_HANDLE) return false;
+
+		VkBufferCopy copyRegion{};
+		copyRegion.size = memory.bufferSize;
+		vkCmdCopyBuffer(defragCommandBuffer, buffer, moved, 1, &copyRegion);
+
+		defragRetired.push_back({ buffer, memory, VK_NULL_HANDLE });
+		buffer = moved;
+		memory = target;
+		return true;
+	}
+
+	// a clone keeps the build, only the handle and device address change
+	bool MainVulkApplication::relocateAccelerationStructure(AccelerationStructure& accelerationStructure) {
+		if (accelerationStructure.handle == VK_NULL_HANDLE) return false;
+		MemoryAllocation target;
+		VkBuffer moved = createRelocatedBuffer(accelerationStructure.memory, target);
+		if (moved == VK_NULL_HANDLE) return false;
+
+		VkAccelerationStructureCreateInfoKHR createInfo{};
+		createInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR;
+		createInfo.buffer = moved;
+		createInfo.size = accelerationStructure.size;
+		createInfo.type = accelerationStructure.type;
+		VkAccelerationStructureKHR handle;
+		check_vk_result(vkCreateAccelerationStructureKHR(device, &createInfo, nullptr, &handle));
+
+		VkCopyAccelerationStructureInfoKHR copyInfo{};
+		copyInfo.sType = VK_STRUCTURE_TYPE_COPY_ACCELERATION_STRUCTURE_INFO_KHR;
+		copyInfo.src = accelerationStructure.handle;
+		copyInfo.dst = handle;
+		copyInfo.mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_CLONE_KHR;
+		vkCmdCopyAccelerationStructureKHR(defragCommandBuffer, &copyInfo);
+
+		defragRetired.push_back({ accelerationStructure.buffer, accelerationStructure.memory, accelerationStructure.handle });
+		accelerationStructure.buffer = moved;
+		accelerationStructure.memory = target;
+		accelerationStructure.handle = handle;
+
+		VkAccelerationStructureDeviceAddressInfoKHR addressInfo{};
+		addressInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR;
+		addressInfo.accelerationStructure = handle;
+		accelerationStructure.deviceAddress = vkGetAccelerationStructureDeviceAddressKHR(device, &addressInfo);
+		return true;
+	}
+}
+
+#endif
@@ -22,21 +22,23 @@ namespace VkApplication {
         accelLayoutBinding.stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR;
         globalBindings.push_back(accelLayoutBinding);
 
-        //UBO
+        //UBO, camera block in the frame ring
         VkDescriptorSetLayoutBinding uniformLayoutBinding{};
         uniformLayoutBinding.binding = bindingCounter++;
-        uniformLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        uniformLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
         uniformLayoutBinding.descriptorCount = 1;
         uniformLayoutBinding.stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR;
         globalBindings.push_back(uniformLayoutBinding);
 
-        //Light buffer
-        VkDescriptorSetLayoutBinding lightBinding{};
-        lightBinding.binding = bindingCounter++;
-        lightBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        lightBinding.descriptorCount = 1;
-        lightBinding.stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR;;
-        globalBindings.push_back(lightBinding);
+        //frame light and render settings blocks, same ring as the UBO, the light block replaced the old light storage buffer
+        for (int block = 0; block < 2; ++block) {
+            VkDescriptorSetLayoutBinding frameBlockBinding{};
+            frameBlockBinding.binding = bindingCounter++;
+            frameBlockBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+            frameBlockBinding.descriptorCount = 1;
+            frameBlockBinding.stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR;
+            globalBindings.push_back(frameBlockBinding);
+        }
 
         VkDescriptorSetLayoutCreateInfo globalLayoutInfo{};
         globalLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -100,15 +102,19 @@ namespace VkApplication {
         SetObjectName(device, reinterpret_cast<uint64_t> (frameDescriptorSetLayout), VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT, "frameDescriptorSetLayout");
     }
 
-    void MainVulkApplication::createDescriptorSets() {
+    // one pool for the three sets of every swapchain image, again after a resize (cleanupSwapChain destroys it)
+    void MainVulkApplication::createDescriptorPool() {
 
+        const uint32_t imageCount = static_cast<uint32_t>(swapChainImages.size());
+        const uint32_t objectCount = std::max<uint32_t>(1, static_cast<uint32_t>(scene.objects.size()));
+        const uint32_t materialCount = std::max<uint32_t>(1, static_cast<uint32_t>(materials.size()));
         std::vector<VkDescriptorPoolSize> poolSizes = {
-            { VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, 1 },
-            { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, swapChainImages.size() * 2 },
-            { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, swapChainImages.size() },
+            { VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, imageCount },
+            { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, imageCount * 2 },
+            { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, imageCount * 3 },
             { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, objectCount }, // transformations
             { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, materialCount },
-            { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, textureCount },
+            { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, materialCount },
         };
 
         VkDescriptorPoolCreateInfo descriptorPoolCreateInfo{};
@@ -118,6 +124,9 @@ namespace VkApplication {
         descriptorPoolCreateInfo.maxSets = swapChainImages.size() * 3 ; // 3 descriptor sets per frame
         check_vk_result(vkCreateDescriptorPool(device, &descriptorPoolCreateInfo, nullptr, &descriptorPool));
         SetObjectName(device, reinterpret_cast<uint64_t> (descriptorPool), VK_OBJECT_TYPE_DESCRIPTOR_POOL, "descriptorPool");
+    }
+
+    void MainVulkApplication::createDescriptorSets() {
 
         std::vector<VkDescriptorSetLayout> layouts = { globalDescriptorSetLayout, materialDescriptorSetLayout, frameDescriptorSetLayout };
 
@@ -139,27 +148,56 @@ namespace VkApplication {
         SetObjectName(device, reinterpret_cast<uint64_t> (materialDescriptorSet[0]), VK_OBJECT_TYPE_DESCRIPTOR_SET, "materialDescriptorSet");
         SetObjectName(device, reinterpret_cast<uint64_t> (frameDescriptorSet[0]), VK_OBJECT_TYPE_DESCRIPTOR_SET, "frameDescriptorSet");
 
-        // TODO : make buffers
+        // the sets only name the ring, bindFrameUniforms picks the frame's blocks through dynamic offsets
         for (size_t i = 0; i < swapChainImages.size(); i++) {
-            VkDescriptorBufferInfo bufferInfo{};
-            bufferInfo.buffer = uniformBuffers[i];
-            bufferInfo.offset = 0;
-            bufferInfo.range = sizeof(UniformBufferObject);
-
-            std::array<VkWriteDescriptorSet, 1> descriptorWrites{};
-
-            descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            descriptorWrites[0].dstSet = descriptorSets[i];
-            descriptorWrites[0].dstBinding = 0;
-            descriptorWrites[0].dstArrayElement = 0;
-            descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-            descriptorWrites[0].descriptorCount = 1;
-            descriptorWrites[0].pBufferInfo = &bufferInfo;
+            const VkDeviceSize ranges[] = { sizeof(UniformBufferObject), sizeof(LightUniformObject), sizeof(RenderSettingsUniform) };
+            const uint32_t bindings[] = { 1, 2, 3 };
+
+            std::array<VkDescriptorBufferInfo, 3> bufferInfos{};
+            std::array<VkWriteDescriptorSet, 3> descriptorWrites{};
+            for (size_t w = 0; w < descriptorWrites.size(); ++w) {
+                bufferInfos[w].buffer = frameUniformBuffer;
+                bufferInfos[w].offset = 0;
+                bufferInfos[w].range = ranges[w];
+
+                descriptorWrites[w].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                descriptorWrites[w].dstSet = globalDescriptorSet[i];
+                descriptorWrites[w].dstBinding = bindings[w];
+                descriptorWrites[w].dstArrayElement = 0;
+                descriptorWrites[w].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+                descriptorWrites[w].descriptorCount = 1;
+                descriptorWrites[w].pBufferInfo = &bufferInfos[w];
+            }
 
             // Updates a descriptor set with a buffer, image, or sampler.
             // Vulkan does not automatically track uniforms/textures like OpenGL.
             vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
         }
+
+        if (topLevelAS.handle != VK_NULL_HANDLE) writeTlasDescriptor();
+    }
+
+    // binding 0 of every global set, again whenever the TLAS gets a new handle (defragmentation)
+    // one vkUpdateDescriptorSets for all of them, the write arrays come from the frame arena
+    void MainVulkApplication::writeTlasDescriptor() {
+        const uint32_t setCount = static_cast<uint32_t>(globalDescriptorSet.size());
+        VkWriteDescriptorSetAccelerationStructureKHR* asInfos = frameArena().allocateArray<VkWriteDescriptorSetAccelerationStructureKHR>(setCount);
+        VkWriteDescriptorSet* descriptorWrites = frameArena().allocateArray<VkWriteDescriptorSet>(setCount);
+        for (uint32_t i = 0; i < setCount; ++i) {
+            asInfos[i] = {};
+            asInfos[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_ACCELERATION_STRUCTURE_KHR;
+            asInfos[i].accelerationStructureCount = 1;
+            asInfos[i].pAccelerationStructures = &topLevelAS.handle;
+
+            descriptorWrites[i] = {};
+            descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrites[i].pNext = &asInfos[i];
+            descriptorWrites[i].dstSet = globalDescriptorSet[i];
+            descriptorWrites[i].dstBinding = 0;
+            descriptorWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+            descriptorWrites[i].descriptorCount = 1;
+        }
+        vkUpdateDescriptorSets(device, setCount, descriptorWrites, 0, nullptr);
     }
 }
 
@@ -74,6 +74,11 @@ namespace VkApplication {
 		enabledBufferDeviceAddresFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES;
 		enabledBufferDeviceAddresFeatures.bufferDeviceAddress = VK_TRUE;
 
+		// staging batches signal a timeline the graphics queue waits on
+		enabledTimelineSemaphoreFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+		enabledTimelineSemaphoreFeatures.timelineSemaphore = VK_TRUE;
+		enabledBufferDeviceAddresFeatures.pNext = &enabledTimelineSemaphoreFeatures;
+
 		enabledRayTracingPipelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_FEATURES_KHR;
 		enabledRayTracingPipelineFeatures.rayTracingPipeline = VK_TRUE;
 		enabledRayTracingPipelineFeatures.pNext = &enabledBufferDeviceAddresFeatures;
@@ -82,6 +87,16 @@ namespace VkApplication {
 		enabledAccelerationStructureFeatures.accelerationStructure = VK_TRUE;
 		enabledAccelerationStructureFeatures.pNext = &enabledRayTracingPipelineFeatures;
 
+		// host builds (vkBuildAccelerationStructuresKHR) only where the implementation offers them, mostly cpu ones
+		VkPhysicalDeviceAccelerationStructureFeaturesKHR supportedAccelerationStructureFeatures{};
+		supportedAccelerationStructureFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR;
+		VkPhysicalDeviceFeatures2 supportedFeatures2{};
+		supportedFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		supportedFeatures2.pNext = &supportedAccelerationStructureFeatures;
+		vkGetPhysicalDeviceFeatures2(physicalDevice, &supportedFeatures2);
+		hostBuildSupported = supportedAccelerationStructureFeatures.accelerationStructureHostCommands == VK_TRUE;
+		enabledAccelerationStructureFeatures.accelerationStructureHostCommands = hostBuildSupported ? VK_TRUE : VK_FALSE;
+
 		deviceCreatepNextChain = &enabledAccelerationStructureFeatures;
 	}
 
@@ -90,6 +105,7 @@ namespace VkApplication {
 
 		std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
 		std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
+		if (indices.transferFamily.has_value()) uniqueQueueFamilies.insert(indices.transferFamily.value());
 
 		float queuePriority = 1.0f;
 		for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -109,8 +125,22 @@ namespace VkApplication {
 		createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 		createInfo.pQueueCreateInfos = queueCreateInfos.data();
 		createInfo.pEnabledFeatures = &deviceFeatures;
-		createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-		createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+		std::vector<const char*> enabledExtensions(deviceExtensions);
+		for (const char* extension : optionalDeviceExtensions) {
+			if (!deviceExtensionAvailable(physicalDevice, extension)) continue;
+			enabledExtensions.push_back(extension);
+			if (strcmp(extension, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0) memoryBudgetSupported = true;
+			if (strcmp(extension, VK_KHR_RAY_QUERY_EXTENSION_NAME) == 0) {
+				// the extension requires the feature, chained in front of the required ones
+				enabledRayQueryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_QUERY_FEATURES_KHR;
+				enabledRayQueryFeatures.rayQuery = VK_TRUE;
+				enabledRayQueryFeatures.pNext = deviceCreatepNextChain;
+				deviceCreatepNextChain = &enabledRayQueryFeatures;
+				rayQuerySupported = true;
+			}
+		}
+		createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+		createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
 		if (enableValidationLayers) {
 			createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
@@ -133,6 +163,38 @@ namespace VkApplication {
 
 		vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
 		vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+
+		graphicsFamilyIndex = indices.graphicsFamily.value();
+		transferFamilyIndex = indices.transferFamily.value_or(graphicsFamilyIndex);
+		if (transferFamilyIndex != graphicsFamilyIndex) vkGetDeviceQueue(device, transferFamilyIndex, 0, &transferQueue);
+		else transferQueue = graphicsQueue;
+
+		// image copies on the transfer family have to be multiples of this, 0 means whole mip levels only
+		uint32_t queueFamilyCount = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+		std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+		transferImageGranularity = queueFamilies[transferFamilyIndex].minImageTransferGranularity;
+		if (transferImageGranularity.width == 0 || transferImageGranularity.height == 0) {
+			// whole mip levels only would stop textures from streaming in bands, the graphics family takes any region
+			transferFamilyIndex = graphicsFamilyIndex;
+			transferQueue = graphicsQueue;
+			transferImageGranularity = { 1, 1, 1 };
+		}
+		std::cout << "uploads : " << (transferFamilyIndex != graphicsFamilyIndex ? "transfer" : "graphics")
+			<< " queue family " << transferFamilyIndex << std::endl;
+	}
+
+	bool MainVulkApplication::deviceExtensionAvailable(VkPhysicalDevice device, const char* name) {
+		uint32_t extensionCount;
+		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+		std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+		for (const auto& extension : availableExtensions)
+			if (strcmp(extension.extensionName, name) == 0) return true;
+		return false;
 	}
 
 	bool MainVulkApplication::checkDeviceExtensionSupport(VkPhysicalDevice device) {
@@ -184,6 +246,16 @@ namespace VkApplication {
 			i++;
 		}
 
+		// a family that can only copy is the DMA engine, uploads on it overlap rendering
+		for (uint32_t family = 0; family < queueFamilyCount; ++family) {
+			const VkQueueFlags flags = queueFamilies[family].queueFlags;
+			if (queueFamilies[family].queueCount > 0 && (flags & VK_QUEUE_TRANSFER_BIT) &&
+				!(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+				indices.transferFamily = family;
+				break;
+			}
+		}
+
 		return indices;
 	}
 }
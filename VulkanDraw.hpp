@@ -3,8 +3,13 @@
 
 namespace VkApplication {
 
+    // geometry the BLAS builds read by device address and the hit shaders fetch as storage buffers
+    constexpr VkBufferUsageFlags RT_GEOMETRY_BUFFER_USAGE = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+        VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR;
+
     void MainVulkApplication::drawFrame() {
         vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+        frameArena().reset();
 
         uint32_t imageIndex;
         VkResult result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, 
@@ -18,7 +23,18 @@ namespace VkApplication {
             throw std::runtime_error("failed to acquire swap chain image!");
         }
 
-        updateUniformBuffer(imageIndex);
+        // the fence above retired the last submission that read this frame's uniform slice
+        updateUniformBuffer(static_cast<uint32_t>(currentFrame));
+        // uploads finished on the transfer queue become the graphics queue's before anything below reads them
+        acquireStaged();
+        // moves at most defragBytesPerFrame, ahead of the TLAS so moved BLAS are re-referenced this frame
+        defragmentStep();
+        // debug placements moved through moveInstance, the TLAS below refits for them
+        animateInstances(renderSettings.time);
+        // debug BLAS updates, the TLAS below refits for their bounds
+        deformObjects();
+        // LOD levels follow the camera that was just written
+        createTLAS();
 
         VkSubmitInfo submitInfo{};
         submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -48,14 +64,13 @@ namespace VkApplication {
         presentInfo.waitSemaphoreCount = 1;
         presentInfo.pWaitSemaphores = signalSemaphores;
 
-        std::vector<VkResult> presentResults(swapChainImages.size());
-
         VkSwapchainKHR swapChains[] = { swapChain };
         presentInfo.swapchainCount = 1;
         presentInfo.pSwapchains = swapChains;
 
         presentInfo.pImageIndices = &imageIndex;
-        presentInfo.pResults = presentResults.data();
+        // one swapchain, one result, pResults is optional and the return value already carries it
+        presentInfo.pResults = nullptr;
 
         result = vkQueuePresentKHR(presentQueue, &presentInfo);
 
@@ -71,74 +86,99 @@ namespace VkApplication {
         //std::cout << currentFrame << std::endl;
     }
 
-    void MainVulkApplication::updateUniformBuffer(uint32_t currentImage) {
+    void MainVulkApplication::updateUniformBuffer(uint32_t frameIndex) {
         static auto startTime = std::chrono::high_resolution_clock::now();
 
         auto currentTime = std::chrono::high_resolution_clock::now();
         float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
 
-        UniformBufferObject ubo{};
+        ubo = UniformBufferObject{};
         ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
         ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
         ubo.proj = glm::perspective(glm::radians(45.0f), swapChainExtent.width / (float)swapChainExtent.height, 0.1f, 10.0f);
         ubo.proj[1][1] *= -1;
 
-        void* data;
-        vkMapMemory(device, uniformBuffersMemory[currentImage], 0, sizeof(ubo), 0, &data);
-        memcpy(data, &ubo, sizeof(ubo));
-        vkUnmapMemory(device, uniformBuffersMemory[currentImage]);
+        renderSettings.frameIndex = frameIndex;
+        renderSettings.vertexLayout = static_cast<uint32_t>(vertexLayout);
+        renderSettings.time = time;
+        renderSettings.lodPixelsPerTriangle = loadOptions.lodPixelsPerTriangle;
+
+        // bump allocated into the mapped ring, no map / unmap on the frame path
+        uint8_t* ring = static_cast<uint8_t*>(frameUniformMemory.mapped);
+        auto push = [&](const void* data, VkDeviceSize size) {
+            VkDeviceSize offset = frameUniformRing.allocate(size);
+            memcpy(ring + offset, data, size);
+            return static_cast<uint32_t>(offset);
+        };
+        frameUniformRing.begin(frameIndex);
+        frameUniformOffsets.camera = push(&ubo, sizeof(ubo));
+        frameUniformOffsets.light = push(&ufo, sizeof(ufo));
+        frameUniformOffsets.settings = push(&renderSettings, sizeof(renderSettings));
     }
 
-    void MainVulkApplication::createVertexBuffer() {
-        VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
-
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingBufferMemory;
-        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
-            stagingBuffer, stagingBufferMemory);
-
-        void* data;
-        // vulkan buffers live on the gpu, so the cpu can't access them directly
-        // maps gpu mem to cpu pointers
-        vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-        // copy mem
-        memcpy(data, vertices.data(), (size_t)bufferSize);
-        // must unmap before gpu access
-        // if VK_MEMORY_PROPERTY_HOST_COHERENT_BIT  was not set, flushing memory would be necessary
-        vkUnmapMemory(device, stagingBufferMemory);
-
-        // device local memory, cannot transfer directly from cpu, so a staging buffer is needed
-        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory);
-
-        copyBuffer(stagingBuffer, vertexBuffer, bufferSize);
+    // set 0 with this frame's ring offsets, dynamic offsets follow the binding order of the global layout
+    void MainVulkApplication::bindFrameUniforms(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint,
+        VkPipelineLayout layout, uint32_t setIndex) {
+        const uint32_t dynamicOffsets[] = { frameUniformOffsets.camera, frameUniformOffsets.light, frameUniformOffsets.settings };
+        vkCmdBindDescriptorSets(commandBuffer, bindPoint, layout, 0, 1, &globalDescriptorSet[setIndex], 3, dynamicOffsets);
+    }
 
-        vkDestroyBuffer(device, stagingBuffer, nullptr);
-        vkFreeMemory(device, stagingBufferMemory, nullptr);
+    void MainVulkApplication::createVertexBuffer() {
+        if (loadOptions.vertexLayout == VertexLayout::Compact && createCompactVertexBuffer()) return;
+        vertexLayout = VertexLayout::Full;
+
+        // the BLAS only reads the positions, they get their own packed stream and the attribute buffer drops them
+        if (loadOptions.splitPositionStream) {
+            createPositionBuffer();
+            uploadBuffer(sizeof(VertexAttributes) * geometry.vertexCount, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | RT_GEOMETRY_BUFFER_USAGE,
+                vertexBuffer, vertexBufferMemory, MemoryCategory::Vertex, [&](void* data) {
+                    VertexAttributes* dst = static_cast<VertexAttributes*>(data);
+                    for (size_t v = 0; v < geometry.vertexCount; ++v) dst[v] = VertexAttributes(geometry.vertices[v]);
+                });
+        }
+        else {
+            // vulkan buffers live on the gpu, so the cpu can't access them directly
+            // the vertices are copied into a mapped staging buffer and transferred to device local memory
+            uploadBuffer(sizeof(Vertex) * geometry.vertexCount, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | RT_GEOMETRY_BUFFER_USAGE,
+                vertexBuffer, vertexBufferMemory, MemoryCategory::Vertex, [&](void* data) {
+                    memcpy(data, geometry.vertices, sizeof(Vertex) * geometry.vertexCount);
+                });
+        }
+        createMeshInfoBuffer();
     }
 
     void MainVulkApplication::createIndexBuffer() {
-        VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
-
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingBufferMemory;
-        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            stagingBuffer, stagingBufferMemory);
+        uploadBuffer(sizeof(uint32_t) * geometry.indexCount, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | RT_GEOMETRY_BUFFER_USAGE,
+            indexBuffer, indexBufferMemory, MemoryCategory::Index, [&](void* data) {
+                memcpy(data, geometry.indices, sizeof(uint32_t) * geometry.indexCount);
+            });
+    }
 
-        void* data;
-        vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-        memcpy(data, indices.data(), (uint32_t)bufferSize);
-        vkUnmapMemory(device, stagingBufferMemory);
+    // device local buffer filled through the staging arena, fill writes straight into the mapped arena when the
+    // buffer fits in one region, bigger ones are filled on the host and streamed through in chunks
+    void MainVulkApplication::uploadBuffer(VkDeviceSize bufferSize, VkBufferUsageFlags usage, VkBuffer& buffer,
+        MemoryAllocation& bufferMemory, MemoryCategory category, const std::function<void(void*)>& fill) {
 
-        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, 
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory);
+        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            buffer, bufferMemory, (usage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) != 0, category);
 
-        copyBuffer(stagingBuffer, indexBuffer, bufferSize);
+        if (bufferSize <= STAGING_ARENA_SIZE / 4) {
+            const VkDeviceSize offset = acquireStaging(bufferSize);
+            // if VK_MEMORY_PROPERTY_HOST_COHERENT_BIT  was not set, flushing memory would be necessary
+            fill(static_cast<uint8_t*>(stagingMemory.mapped) + offset);
 
-        vkDestroyBuffer(device, stagingBuffer, nullptr);
-        vkFreeMemory(device, stagingBufferMemory, nullptr);
+            VkBufferCopy copyRegion{};
+            copyRegion.srcOffset = offset;
+            copyRegion.size = bufferSize;
+            vkCmdCopyBuffer(stagingCommandBuffer, stagingBuffer, buffer, 1, &copyRegion);
+        }
+        else {
+            std::vector<uint8_t> data(static_cast<size_t>(bufferSize));
+            fill(data.data());
+            stageToBuffer(buffer, 0, data.data(), bufferSize);
+        }
+        releaseStagedBuffer(buffer);
+        finishUpload();
     }
 
     void MainVulkApplication::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
@@ -152,7 +192,12 @@ namespace VkApplication {
     }
 
     void MainVulkApplication::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, 
-        VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory, bool deviceAddressCond) {
+        VkMemoryPropertyFlags properties, VkBuffer& buffer, MemoryAllocation& bufferMemory, bool deviceAddressCond,
+        MemoryCategory category) {
+        // device local buffers can be relocated by the defragmenter, which copies them
+        if (!(properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT))
+            usage |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
         VkBufferCreateInfo bufferInfo{};
         bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
         bufferInfo.size = size;
@@ -169,86 +214,75 @@ namespace VkApplication {
         VkMemoryRequirements memRequirements;
         vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
 
-        VkMemoryAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memRequirements.size;
-        allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-        allocInfo.pNext = NULL;
-
-        VkMemoryAllocateFlagsInfo allocFlagsInfo{};
-        if (deviceAddressCond) {
-            allocFlagsInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO;
-            allocFlagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT; // Allocate memory with device address bit
-            allocFlagsInfo.deviceMask = 0;
-            allocInfo.pNext = &allocFlagsInfo;
-        }
-
-        if (vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-            throw std::runtime_error("failed to allocate buffer memory!");
-        }
+        // sub-allocated from a pool block, device address buffers get pools whose blocks carry VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT
+        bufferMemory = memoryManager.allocate(memRequirements, properties, deviceAddressCond, category);
+        bufferMemory.usage = usage;
+        bufferMemory.bufferSize = size;
 
-        vkBindBufferMemory(device, buffer, bufferMemory, 0);
+        vkBindBufferMemory(device, buffer, bufferMemory.memory, bufferMemory.offset);
     }
 
-    void MainVulkApplication::createGeometryBuffer(std::vector<Vertex>& geoData, VkBuffer& geoBuffer, VkDeviceMemory& geoBufferMemory) {
+    // null safe, leaves both handles empty so a second call is harmless
+    void MainVulkApplication::destroyBuffer(VkBuffer& buffer, MemoryAllocation& bufferMemory) {
+        if (buffer != VK_NULL_HANDLE) vkDestroyBuffer(device, buffer, nullptr);
+        memoryManager.free(bufferMemory);
+        buffer = VK_NULL_HANDLE;
+    }
 
-        VkDeviceSize bufferSize = sizeof(geoData[0]) * geoData.size();
+    // allocation traffic of everything between waitForAssets and the first TLAS
+    void MainVulkApplication::reportSceneMemory(const MemoryPoolStats& start, std::chrono::high_resolution_clock::time_point startTime) {
+        using std::cout; using std::endl;
+        const MemoryPoolStats now = memoryManager.getStats();
+        const double mb = 1.0 / (1024.0 * 1024.0);
+        cout << "scene memory : " << elapsedMs(startTime, std::chrono::high_resolution_clock::now()) << " ms upload, "
+            << now.allocations - start.allocations << " allocations (" << now.frees - start.frees << " freed) in "
+            << now.allocateMs - start.allocateMs << " ms" << endl;
+        cout << "\tvkAllocateMemory : " << now.deviceAllocations - start.deviceAllocations << " calls, "
+            << now.blocks << " live blocks, " << now.reservedBytes * mb << " MB reserved, " << now.usedBytes * mb << " MB used" << endl;
+        cout << "\tstaging (" << (loadOptions.batchUploads ? "batched" : "per upload") << ") : " << stagingStats.uploads << " uploads, " << stagingStats.bytes * mb << " MB in " << stagingStats.chunks
+            << " chunks, " << stagingStats.submits << " submits, " << stagingStats.waits << " waits, "
+            << stagingStats.acquires << " acquires, peak " << stagingStats.peakBytes * mb << " MB" << endl;
+        cout << "\tbuild scratch : " << scratchBuffer.capacity * mb << " MB pool, " << scratchBuffer.ranges << " ranges, "
+            << scratchBuffer.grows << " grows" << endl;
+    }
 
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingBufferMemory;
-        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            stagingBuffer, stagingBufferMemory);
+    void MainVulkApplication::createGeometryBuffer(std::vector<Vertex>& geoData, VkBuffer& geoBuffer, MemoryAllocation& geoBufferMemory) {
 
-        void* data;
-        vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-        memcpy(data, geoData.data(), static_cast<size_t>(bufferSize));
-        vkUnmapMemory(device, stagingBufferMemory);
+        VkDeviceSize bufferSize = sizeof(geoData[0]) * geoData.size();
 
         createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, geoBuffer, geoBufferMemory);
-
-        copyBuffer(stagingBuffer, geoBuffer, bufferSize);
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, geoBuffer, geoBufferMemory, false, MemoryCategory::Vertex);
 
-        vkDestroyBuffer(device, stagingBuffer, nullptr);
-        vkFreeMemory(device, stagingBufferMemory, nullptr);
+        stageToBuffer(geoBuffer, 0, geoData.data(), bufferSize);
+        releaseStagedBuffer(geoBuffer);
+        finishUpload();
     }
 
-    void MainVulkApplication::createIndexBuffer(std::vector<uint32_t>& geoData, VkBuffer& geoBuffer, VkDeviceMemory& geoBufferMemory) {
+    void MainVulkApplication::createIndexBuffer(std::vector<uint32_t>& geoData, VkBuffer& geoBuffer, MemoryAllocation& geoBufferMemory) {
 
         VkDeviceSize bufferSize = sizeof(geoData[0]) * geoData.size();
 
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingBufferMemory;
-        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            stagingBuffer, stagingBufferMemory);
-
-        void* data;
-        vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-        memcpy(data, geoData.data(), static_cast<size_t>(bufferSize));
-        vkUnmapMemory(device, stagingBufferMemory);
-
         createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, geoBuffer, geoBufferMemory);
-
-        copyBuffer(stagingBuffer, geoBuffer, bufferSize);
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, geoBuffer, geoBufferMemory, false, MemoryCategory::Index);
 
-        vkDestroyBuffer(device, stagingBuffer, nullptr);
-        vkFreeMemory(device, stagingBufferMemory, nullptr);
+        stageToBuffer(geoBuffer, 0, geoData.data(), bufferSize);
+        releaseStagedBuffer(geoBuffer);
+        finishUpload();
     }
 
+    // room for a few times this frame's blocks, each slice is reused once its frame's fence has signalled
     void MainVulkApplication::createUniformBuffers() {
-        VkDeviceSize bufferSize = sizeof(UniformBufferObject);
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        const VkDeviceSize alignment = properties.limits.minUniformBufferOffsetAlignment;
 
-        uniformBuffers.resize(swapChainImages.size());
-        uniformBuffersMemory.resize(swapChainImages.size());
+        const VkDeviceSize frameBytes = 4 * (align_up<VkDeviceSize>(sizeof(UniformBufferObject), alignment) +
+            align_up<VkDeviceSize>(sizeof(LightUniformObject), alignment) + align_up<VkDeviceSize>(sizeof(RenderSettingsUniform), alignment));
+        frameUniformRing = FrameRingAllocator(MAX_FRAMES_IN_FLIGHT, frameBytes, alignment);
 
-        for (size_t i = 0; i < swapChainImages.size(); i++) {
-            createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, 
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
-                uniformBuffers[i], uniformBuffersMemory[i]);
-        }
+        createBuffer(frameUniformRing.totalSize(), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            frameUniformBuffer, frameUniformMemory, false, MemoryCategory::Uniform);
     }
 
     void MainVulkApplication::createCommandBuffers() {
@@ -291,15 +325,23 @@ namespace VkApplication {
 
             vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
 
-            VkBuffer vertexBuffers[] = { vertexBuffer };
-            VkDeviceSize offsets[] = { 0 };
-            vkCmdBindVertexBuffers(commandBuffers[i], 0, 1, vertexBuffers, offsets);
+            // the raster preview reads the full Vertex layout, compact scenes are ray traced only
+            if (vertexLayout != VertexLayout::Full) {
+                vkCmdEndRenderPass(commandBuffers[i]);
+                check_vk_result(vkEndCommandBuffer(commandBuffers[i]));
+                continue;
+            }
+
+            // split scenes feed pos from the position stream at binding 1, see VertexAttributes
+            VkBuffer vertexBuffers[] = { vertexBuffer, positionBuffer };
+            VkDeviceSize offsets[] = { 0, 0 };
+            vkCmdBindVertexBuffers(commandBuffers[i], 0, positionBuffer != VK_NULL_HANDLE ? 2 : 1, vertexBuffers, offsets);
 
             vkCmdBindIndexBuffer(commandBuffers[i], indexBuffer, 0, VK_INDEX_TYPE_UINT32);
             
             vkCmdBindDescriptorSets(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[i], 0, nullptr);
 
-            vkCmdDrawIndexed(commandBuffers[i], static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
+            vkCmdDrawIndexed(commandBuffers[i], sceneIndexCount(), 1, 0, 0, 0);
 
             vkCmdEndRenderPass(commandBuffers[i]);
 
@@ -359,16 +401,25 @@ namespace VkApplication {
         return commandBuffer;
     }
 
+    // waits for this submission only, uploads still running on the transfer queue are left alone
     void MainVulkApplication::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
         check_vk_result(vkEndCommandBuffer(commandBuffer));
+        acquireStaged();
+
+        if (singleTimeFence == VK_NULL_HANDLE) {
+            VkFenceCreateInfo fenceInfo{};
+            fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+            check_vk_result(vkCreateFence(device, &fenceInfo, nullptr, &singleTimeFence));
+        }
 
         VkSubmitInfo submitInfo{};
         submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
         submitInfo.commandBufferCount = 1;
         submitInfo.pCommandBuffers = &commandBuffer;
 
-        check_vk_result(vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE));
-        check_vk_result(vkQueueWaitIdle(graphicsQueue));
+        check_vk_result(vkQueueSubmit(graphicsQueue, 1, &submitInfo, singleTimeFence));
+        check_vk_result(vkWaitForFences(device, 1, &singleTimeFence, VK_TRUE, UINT64_MAX));
+        check_vk_result(vkResetFences(device, 1, &singleTimeFence));
 
         vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
     }
@@ -0,0 +1,615 @@
+#ifndef __VK_GLB_HPP__
+#define __VK_GLB_HPP__
+
+/*
+Native reader for binary glTF (.glb) that skips Assimp's scene graph.
+
+	/---------------------------\
+	| header  magic version len |
+	|---------------------------|
+	| chunk 0 : JSON            |
+	|---------------------------|
+	| chunk 1 : BIN             |
+	\---------------------------/
+
+The file is mapped, the JSON chunk is parsed into a small DOM, accessors / bufferViews are resolved to raw
+pointers into the BIN chunk and each attribute stream is copied with a strided loop straight into the Vertex slice
+of its primitive. Output matches loadModel's Assimp path: one MeshRange per primitive, indices rebased to the
+global vertex array, raw glTF uvs (Assimp's importer flip + FlipUVs cancel out) and generated normals when a
+primitive has none. The node graph of the default scene becomes MeshInstances, one per primitive of every node's
+mesh. Anything the reader does not handle throws and loadModel falls back to Assimp.
+*/
+
+namespace VkApplication {
+
+	// minimal DOM for the JSON chunk, numbers are kept as double
+	struct JsonValue {
+		enum class Type { Null, Bool, Number, String, Array, Object };
+
+		Type type = Type::Null;
+		bool boolean = false;
+		double number = 0.0;
+		std::string string;
+		std::vector<JsonValue> array;
+		std::vector<std::pair<std::string, JsonValue>> object;
+
+		static const JsonValue& null() {
+			static const JsonValue value;
+			return value;
+		}
+
+		bool isNull() const { return type == Type::Null; }
+		size_t size() const { return type == Type::Array ? array.size() : object.size(); }
+
+		const JsonValue& operator[](const char* key) const {
+			if (type == Type::Object)
+				for (const auto& member : object)
+					if (member.first == key) return member.second;
+			return null();
+		}
+
+		const JsonValue& operator[](size_t index) const {
+			return (type == Type::Array && index < array.size()) ? array[index] : null();
+		}
+
+		double asNumber(double fallback = 0.0) const { return type == Type::Number ? number : fallback; }
+		int64_t asInt(int64_t fallback = -1) const { return type == Type::Number ? static_cast<int64_t>(number) : fallback; }
+	};
+
+	class JsonParser {
+	private:
+		const char* cursor;
+		const char* end;
+
+		[[noreturn]] void fail(const char* what) {
+			throw std::runtime_error(std::string("glb : bad json, ") + what);
+		}
+
+		void skipWhitespace() {
+			while (cursor < end && (*cursor == ' ' || *cursor == '\t' || *cursor == '\n' || *cursor == '\r')) ++cursor;
+		}
+
+		bool consume(char c) {
+			skipWhitespace();
+			if (cursor < end && *cursor == c) { ++cursor; return true; }
+			return false;
+		}
+
+		void expect(char c) {
+			if (!consume(c)) fail("unexpected character");
+		}
+
+		bool matchLiteral(const char* literal) {
+			size_t length = strlen(literal);
+			if (static_cast<size_t>(end - cursor) < length || strncmp(cursor, literal, length) != 0) return false;
+			cursor += length;
+			return true;
+		}
+
+		static void appendUtf8(std::string& out, uint32_t codepoint) {
+			if (codepoint < 0x80) out += static_cast<char>(codepoint);
+			else if (codepoint < 0x800) {
+				out += static_cast<char>(0xC0 | (codepoint >> 6));
+				out += static_cast<char>(0x80 | (codepoint & 0x3F));
+			}
+			else if (codepoint < 0x10000) {
+				out += static_cast<char>(0xE0 | (codepoint >> 12));
+				out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+				out += static_cast<char>(0x80 | (codepoint & 0x3F));
+			}
+			else {
+				out += static_cast<char>(0xF0 | (codepoint >> 18));
+				out += static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F));
+				out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+				out += static_cast<char>(0x80 | (codepoint & 0x3F));
+			}
+		}
+
+		uint32_t parseHex4() {
+			if (end - cursor < 4) fail("short \\u escape");
+			uint32_t value = 0;
+			for (int i = 0; i < 4; ++i) {
+				char c = *cursor++;
+				value <<= 4;
+				if (c >= '0' && c <= '9') value |= c - '0';
+				else if (c >= 'a' && c <= 'f') value |= c - 'a' + 10;
+				else if (c >= 'A' && c <= 'F') value |= c - 'A' + 10;
+				else fail("bad \\u escape");
+			}
+			return value;
+		}
+
+		std::string parseString() {
+			expect('"');
+			std::string out;
+			while (cursor < end && *cursor != '"') {
+				char c = *cursor++;
+				if (c != '\\') { out += c; continue; }
+				if (cursor >= end) fail("unterminated escape");
+				switch (*cursor++) {
+				case '"': out += '"'; break;
+				case '\\': out += '\\'; break;
+				case '/': out += '/'; break;
+				case 'b': out += '\b'; break;
+				case 'f': out += '\f'; break;
+				case 'n': out += '\n'; break;
+				case 'r': out += '\r'; break;
+				case 't': out += '\t'; break;
+				case 'u': {
+					uint32_t codepoint = parseHex4();
+					if (codepoint >= 0xD800 && codepoint <= 0xDBFF && end - cursor >= 6 && cursor[0] == '\\' && cursor[1] == 'u') {
+						cursor += 2;
+						uint32_t low = parseHex4();
+						codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+					}
+					appendUtf8(out, codepoint);
+					break;
+				}
+				default: fail("unknown escape");
+				}
+			}
+			if (cursor >= end) fail("unterminated string");
+			++cursor;
+			return out;
+		}
+
+		JsonValue parseValue(int depth) {
+			if (depth > 128) fail("nesting too deep");
+			skipWhitespace();
+			if (cursor >= end) fail("unexpected end");
+
+			JsonValue value;
+			char c = *cursor;
+			if (c == '{') {
+				++cursor;
+				value.type = JsonValue::Type::Object;
+				if (consume('}')) return value;
+				do {
+					skipWhitespace();
+					std::string key = parseString();
+					expect(':');
+					value.object.emplace_back(std::move(key), parseValue(depth + 1));
+				} while (consume(','));
+				expect('}');
+			}
+			else if (c == '[') {
+				++cursor;
+				value.type = JsonValue::Type::Array;
+				if (consume(']')) return value;
+				do {
+					value.array.push_back(parseValue(depth + 1));
+				} while (consume(','));
+				expect(']');
+			}
+			else if (c == '"') {
+				value.type = JsonValue::Type::String;
+				value.string = parseString();
+			}
+			else if (matchLiteral("true")) { value.type = JsonValue::Type::Bool; value.boolean = true; }
+			else if (matchLiteral("false")) { value.type = JsonValue::Type::Bool; value.boolean = false; }
+			else if (matchLiteral("null")) { value.type = JsonValue::Type::Null; }
+			else {
+				// the chunk is not null terminated, copy the token out before strtod reads it
+				const char* start = cursor;
+				while (cursor < end && (isdigit(static_cast<unsigned char>(*cursor)) || *cursor == '-' || *cursor == '+' ||
+					*cursor == '.' || *cursor == 'e' || *cursor == 'E')) ++cursor;
+				if (start == cursor) fail("unexpected token");
+				std::string token(start, cursor);
+				char* parsedEnd = nullptr;
+				value.type = JsonValue::Type::Number;
+				value.number = strtod(token.c_str(), &parsedEnd);
+				if (parsedEnd != token.c_str() + token.size()) fail("bad number");
+			}
+			return value;
+		}
+
+	public:
+		JsonParser(const char* text, size_t length) : cursor(text), end(text + length) {}
+
+		JsonValue parse() {
+			JsonValue root = parseValue(0);
+			skipWhitespace();
+			if (cursor != end) fail("trailing data");
+			return root;
+		}
+	};
+
+	constexpr uint32_t GLB_MAGIC = 0x46546C67;      // "glTF"
+	constexpr uint32_t GLB_CHUNK_JSON = 0x4E4F534A; // "JSON"
+	constexpr uint32_t GLB_CHUNK_BIN = 0x004E4942;  // "BIN\0"
+
+	enum GltfComponentType : uint32_t {
+		GLTF_BYTE = 5120,
+		GLTF_UNSIGNED_BYTE = 5121,
+		GLTF_SHORT = 5122,
+		GLTF_UNSIGNED_SHORT = 5123,
+		GLTF_UNSIGNED_INT = 5125,
+		GLTF_FLOAT = 5126
+	};
+
+	enum GltfPrimitiveMode : int64_t {
+		GLTF_TRIANGLES = 4,
+		GLTF_TRIANGLE_STRIP = 5,
+		GLTF_TRIANGLE_FAN = 6
+	};
+
+	// accessor resolved to a raw strided view of the BIN chunk
+	struct GlbAccessor {
+		const uint8_t* data = nullptr;
+		size_t count = 0;
+		size_t stride = 0;
+		uint32_t componentType = 0;
+		uint32_t components = 0;
+		bool normalized = false;
+	};
+
+	uint32_t gltfComponentSize(uint32_t componentType) {
+		switch (componentType) {
+		case GLTF_BYTE: case GLTF_UNSIGNED_BYTE: return 1;
+		case GLTF_SHORT: case GLTF_UNSIGNED_SHORT: return 2;
+		case GLTF_UNSIGNED_INT: case GLTF_FLOAT: return 4;
+		default: throw std::runtime_error("glb : unknown component type");
+		}
+	}
+
+	uint32_t gltfComponentCount(const std::string& type) {
+		if (type == "SCALAR") return 1;
+		if (type == "VEC2") return 2;
+		if (type == "VEC3") return 3;
+		if (type == "VEC4") return 4;
+		throw std::runtime_error("glb : unsupported accessor type " + type);
+	}
+
+	GlbAccessor resolveGlbAccessor(const JsonValue& gltf, int64_t index, const uint8_t* bin, size_t binSize) {
+		const JsonValue& accessor = gltf["accessors"][static_cast<size_t>(index)];
+		if (index < 0 || accessor.isNull()) throw std::runtime_error("glb : accessor out of range");
+		if (!accessor["sparse"].isNull()) throw std::runtime_error("glb : sparse accessors not supported");
+
+		const JsonValue& view = gltf["bufferViews"][static_cast<size_t>(accessor["bufferView"].asInt())];
+		if (view.isNull()) throw std::runtime_error("glb : accessor without bufferView");
+		if (view["buffer"].asInt(0) != 0) throw std::runtime_error("glb : external buffers not supported");
+
+		GlbAccessor result;
+		result.count = static_cast<size_t>(accessor["count"].asInt(0));
+		result.componentType = static_cast<uint32_t>(accessor["componentType"].asInt(0));
+		result.components = gltfComponentCount(accessor["type"].string);
+		result.normalized = accessor["normalized"].boolean;
+
+		const size_t elementSize = gltfComponentSize(result.componentType) * result.components;
+		result.stride = static_cast<size_t>(view["byteStride"].asInt(0));
+		if (result.stride == 0) result.stride = elementSize;
+
+		const uint64_t viewOffset = static_cast<uint64_t>(view["byteOffset"].asInt(0));
+		const uint64_t viewLength = static_cast<uint64_t>(view["byteLength"].asInt(0));
+		const uint64_t accessorOffset = static_cast<uint64_t>(accessor["byteOffset"].asInt(0));
+		if (viewOffset + viewLength > binSize) throw std::runtime_error("glb : bufferView outside BIN chunk");
+		if (result.count && accessorOffset + result.stride * (result.count - 1) + elementSize > viewLength)
+			throw std::runtime_error("glb : accessor outside its bufferView");
+
+		result.data = bin + viewOffset + accessorOffset;
+		return result;
+	}
+
+	float readGltfComponent(const uint8_t* src, uint32_t componentType, bool normalized) {
+		switch (componentType) {
+		case GLTF_FLOAT: { float v; memcpy(&v, src, 4); return v; }
+		case GLTF_UNSIGNED_BYTE: return normalized ? src[0] / 255.0f : float(src[0]);
+		case GLTF_BYTE: { int8_t v; memcpy(&v, src, 1); return normalized ? std::max(v / 127.0f, -1.0f) : float(v); }
+		case GLTF_UNSIGNED_SHORT: { uint16_t v; memcpy(&v, src, 2); return normalized ? v / 65535.0f : float(v); }
+		case GLTF_SHORT: { int16_t v; memcpy(&v, src, 2); return normalized ? std::max(v / 32767.0f, -1.0f) : float(v); }
+		case GLTF_UNSIGNED_INT: { uint32_t v; memcpy(&v, src, 4); return float(v); }
+		default: return 0.0f;
+		}
+	}
+
+	// strided copy of one attribute stream into the matching Vertex member, float streams are plain memcpy per element
+	void copyGlbStream(const GlbAccessor& accessor, uint32_t components, Vertex* dst, size_t memberOffset) {
+		if (accessor.components < components) throw std::runtime_error("glb : attribute has too few components");
+
+		uint8_t* out = reinterpret_cast<uint8_t*>(dst) + memberOffset;
+		const uint8_t* in = accessor.data;
+
+		if (accessor.componentType == GLTF_FLOAT) {
+			const size_t bytes = components * sizeof(float);
+			for (size_t i = 0; i < accessor.count; ++i, out += sizeof(Vertex), in += accessor.stride)
+				memcpy(out, in, bytes);
+			return;
+		}
+
+		const uint32_t componentSize = gltfComponentSize(accessor.componentType);
+		for (size_t i = 0; i < accessor.count; ++i, out += sizeof(Vertex), in += accessor.stride) {
+			for (uint32_t c = 0; c < components; ++c) {
+				float value = readGltfComponent(in + c * componentSize, accessor.componentType, accessor.normalized);
+				memcpy(out + c * sizeof(float), &value, sizeof(float));
+			}
+		}
+	}
+
+	uint32_t readGltfIndex(const GlbAccessor& accessor, size_t i) {
+		const uint8_t* src = accessor.data + i * accessor.stride;
+		switch (accessor.componentType) {
+		case GLTF_UNSIGNED_BYTE: return src[0];
+		case GLTF_UNSIGNED_SHORT: { uint16_t v; memcpy(&v, src, 2); return v; }
+		case GLTF_UNSIGNED_INT: { uint32_t v; memcpy(&v, src, 4); return v; }
+		default: throw std::runtime_error("glb : bad index component type");
+		}
+	}
+
+	uint32_t gltfTriangleIndexCount(int64_t mode, size_t count) {
+		if (mode == GLTF_TRIANGLES) return static_cast<uint32_t>(count - count % 3);
+		return count < 3 ? 0 : static_cast<uint32_t>((count - 2) * 3);
+	}
+
+	// area weighted smooth normals, only for primitives that ship without NORMAL
+	void generateGlbNormals(Vertex* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount, uint32_t baseVertex) {
+		for (uint32_t v = 0; v < vertexCount; ++v) vertices[v].normal = glm::vec3(0.0f);
+		for (uint32_t i = 0; i + 2 < indexCount; i += 3) {
+			Vertex& a = vertices[indices[i] - baseVertex];
+			Vertex& b = vertices[indices[i + 1] - baseVertex];
+			Vertex& c = vertices[indices[i + 2] - baseVertex];
+			glm::vec3 faceNormal = glm::cross(b.pos - a.pos, c.pos - a.pos);
+			a.normal += faceNormal;
+			b.normal += faceNormal;
+			c.normal += faceNormal;
+		}
+		for (uint32_t v = 0; v < vertexCount; ++v) {
+			float length = glm::length(vertices[v].normal);
+			vertices[v].normal = length > 0.0f ? vertices[v].normal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+		}
+	}
+
+	// local matrix of a node, either "matrix" (column major) or translation * rotation * scale
+	glm::mat4 gltfNodeTransform(const JsonValue& node) {
+		const JsonValue& matrix = node["matrix"];
+		if (matrix.size() == 16) {
+			glm::mat4 m;
+			for (size_t i = 0; i < 16; ++i) m[int(i / 4)][int(i % 4)] = float(matrix[i].asNumber());
+			return m;
+		}
+
+		const JsonValue& t = node["translation"];
+		const JsonValue& r = node["rotation"];
+		const JsonValue& s = node["scale"];
+		glm::vec3 translation(float(t[size_t(0)].asNumber(0.0)), float(t[size_t(1)].asNumber(0.0)), float(t[size_t(2)].asNumber(0.0)));
+		// glTF stores x y z w, glm::quat takes w first
+		glm::quat rotation(float(r[size_t(3)].asNumber(1.0)), float(r[size_t(0)].asNumber(0.0)), float(r[size_t(1)].asNumber(0.0)), float(r[size_t(2)].asNumber(0.0)));
+		glm::vec3 scale(float(s[size_t(0)].asNumber(1.0)), float(s[size_t(1)].asNumber(1.0)), float(s[size_t(2)].asNumber(1.0)));
+		return glm::translate(glm::mat4(1.0f), translation) * glm::mat4_cast(rotation) * glm::scale(glm::mat4(1.0f), scale);
+	}
+
+	// walks the default scene, a file without scenes places every root node
+	// nodes under an animation channel are rigid, skins, morph targets and weight channels deforming
+	void collectGltfInstances(const JsonValue& gltf, const std::vector<std::vector<uint32_t>>& meshPrimitiveRanges,
+		std::vector<MeshInstance>& instances) {
+
+		const JsonValue& nodes = gltf["nodes"];
+		const JsonValue& meshes = gltf["meshes"];
+		std::vector<uint8_t> nodeAnimated(nodes.size(), 0), nodeMorphed(nodes.size(), 0);
+		const JsonValue& animations = gltf["animations"];
+		for (size_t a = 0; a < animations.size(); ++a) {
+			const JsonValue& channels = animations[a]["channels"];
+			for (size_t c = 0; c < channels.size(); ++c) {
+				const JsonValue& target = channels[c]["target"];
+				const int64_t n = target["node"].asInt();
+				if (n < 0 || size_t(n) >= nodes.size()) continue;
+				if (target["path"].string == "weights") nodeMorphed[size_t(n)] = 1;
+				else nodeAnimated[size_t(n)] = 1;
+			}
+		}
+		auto meshMorphs = [&](int64_t mesh) {
+			const JsonValue& meshPrimitives = meshes[size_t(mesh)]["primitives"];
+			for (size_t p = 0; p < meshPrimitives.size(); ++p)
+				if (meshPrimitives[p]["targets"].size()) return true;
+			return false;
+		};
+
+		struct Visit { size_t node; glm::mat4 parent; bool animated; };
+		std::vector<Visit> stack;
+
+		const JsonValue& scenes = gltf["scenes"];
+		if (scenes.size()) {
+			const JsonValue& roots = scenes[size_t(gltf["scene"].asInt(0))]["nodes"];
+			for (size_t r = roots.size(); r-- > 0;) stack.push_back({ size_t(roots[r].asInt()), glm::mat4(1.0f), false });
+		}
+		else {
+			std::vector<uint8_t> isChild(nodes.size(), 0);
+			for (size_t n = 0; n < nodes.size(); ++n) {
+				const JsonValue& children = nodes[n]["children"];
+				for (size_t c = 0; c < children.size(); ++c)
+					if (size_t(children[c].asInt()) < nodes.size()) isChild[size_t(children[c].asInt())] = 1;
+			}
+			for (size_t n = nodes.size(); n-- > 0;) if (!isChild[n]) stack.push_back({ n, glm::mat4(1.0f), false });
+		}
+
+		// glTF nodes have at most one parent, more visits than nodes means a cycle
+		size_t visited = 0;
+		while (!stack.empty()) {
+			auto [n, parent, animatedParent] = stack.back();
+			stack.pop_back();
+			if (n >= nodes.size()) throw std::runtime_error("glb : node index out of range");
+			if (++visited > nodes.size()) throw std::runtime_error("glb : node graph is not a tree");
+
+			const JsonValue& node = nodes[n];
+			const glm::mat4 world = parent * gltfNodeTransform(node);
+			const bool animated = animatedParent || nodeAnimated[n];
+
+			int64_t mesh = node["mesh"].asInt();
+			if (mesh >= 0 && size_t(mesh) < meshPrimitiveRanges.size()) {
+				ObjectMotion motion = animated ? ObjectMotion::Rigid : ObjectMotion::Static;
+				if (node["skin"].asInt() >= 0 || nodeMorphed[n] || meshMorphs(mesh)) motion = ObjectMotion::Deforming;
+				for (uint32_t range : meshPrimitiveRanges[size_t(mesh)]) {
+					MeshInstance instance;
+					instance.transform = world;
+					instance.mesh = range;
+					instance.motion = static_cast<uint32_t>(motion);
+					instances.push_back(instance);
+				}
+			}
+
+			const JsonValue& children = node["children"];
+			for (size_t c = children.size(); c-- > 0;) stack.push_back({ size_t(children[c].asInt()), world, animated });
+		}
+	}
+
+	void loadGLBModel(const std::string& path, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices,
+		std::vector<MeshRange>& meshRanges, std::vector<Material>& materials, std::vector<MeshInstance>& instances, ThreadPool* pool) {
+
+		MappedFile file;
+		if (!file.open(path)) throw std::runtime_error("glb : cannot open " + path);
+
+		const uint8_t* base = file.data();
+		const size_t fileSize = file.size();
+		auto readU32 = [&](size_t offset) {
+			uint32_t value;
+			memcpy(&value, base + offset, 4);
+			return value;
+		};
+
+		if (fileSize < 20 || readU32(0) != GLB_MAGIC || readU32(4) != 2 || readU32(8) > fileSize)
+			throw std::runtime_error("glb : not a glTF 2.0 binary");
+
+		const uint32_t jsonLength = readU32(12);
+		if (readU32(16) != GLB_CHUNK_JSON || 20ull + jsonLength > fileSize)
+			throw std::runtime_error("glb : missing JSON chunk");
+
+		const uint8_t* bin = nullptr;
+		size_t binSize = 0;
+		const size_t binHeader = 20 + align_up<size_t>(jsonLength, 4);
+		if (binHeader + 8 <= fileSize && readU32(binHeader + 4) == GLB_CHUNK_BIN) {
+			binSize = readU32(binHeader);
+			bin = base + binHeader + 8;
+			if (binHeader + 8 + binSize > fileSize) throw std::runtime_error("glb : truncated BIN chunk");
+		}
+
+		const JsonValue gltf = JsonParser(reinterpret_cast<const char*>(base + 20), jsonLength).parse();
+
+		// materials keep the glTF order, primitives without one share a default appended at the end
+		const JsonValue& gltfMaterials = gltf["materials"];
+		materials.assign(gltfMaterials.size() + 1, Material{});
+		for (size_t i = 0; i < gltfMaterials.size(); ++i) {
+			const JsonValue& pbr = gltfMaterials[i]["pbrMetallicRoughness"];
+			Material& material = materials[i];
+			const JsonValue& factor = pbr["baseColorFactor"];
+			material.basecolor = glm::vec4(
+				float(factor[size_t(0)].asNumber(1.0)), float(factor[size_t(1)].asNumber(1.0)),
+				float(factor[size_t(2)].asNumber(1.0)), float(factor[size_t(3)].asNumber(1.0)));
+			material.metallicFactor = float(pbr["metallicFactor"].asNumber(1.0));
+			material.roughnessFactor = float(pbr["roughnessFactor"].asNumber(1.0));
+		}
+		materials.back().basecolor = glm::vec4(1.0f);
+		const uint32_t defaultMaterial = static_cast<uint32_t>(gltfMaterials.size());
+
+		struct GlbPrimitive {
+			const JsonValue* json;
+			int64_t mode;
+			GlbAccessor positions;
+			bool indexed;
+			GlbAccessor indices;
+		};
+
+		std::vector<GlbPrimitive> primitives;
+		meshRanges.clear();
+
+		uint64_t vertexTotal = 0, indexTotal = 0;
+		const JsonValue& meshes = gltf["meshes"];
+		std::vector<std::vector<uint32_t>> meshPrimitiveRanges(meshes.size());
+		for (size_t m = 0; m < meshes.size(); ++m) {
+			const JsonValue& meshPrimitives = meshes[m]["primitives"];
+			for (size_t p = 0; p < meshPrimitives.size(); ++p) {
+				const JsonValue& primitive = meshPrimitives[p];
+				int64_t mode = primitive["mode"].asInt(GLTF_TRIANGLES);
+				// points and lines never reach the BLAS
+				if (mode != GLTF_TRIANGLES && mode != GLTF_TRIANGLE_STRIP && mode != GLTF_TRIANGLE_FAN) continue;
+
+				int64_t positionAccessor = primitive["attributes"]["POSITION"].asInt();
+				if (positionAccessor < 0) continue;
+
+				GlbPrimitive entry{ &primitive, mode, resolveGlbAccessor(gltf, positionAccessor, bin, binSize), false, {} };
+				if (entry.positions.componentType != GLTF_FLOAT) throw std::runtime_error("glb : quantized positions not supported");
+
+				size_t elementCount = entry.positions.count;
+				int64_t indexAccessor = primitive["indices"].asInt();
+				if (indexAccessor >= 0) {
+					entry.indexed = true;
+					entry.indices = resolveGlbAccessor(gltf, indexAccessor, bin, binSize);
+					elementCount = entry.indices.count;
+				}
+
+				MeshRange range;
+				range.firstVertex = static_cast<uint32_t>(vertexTotal);
+				range.vertexCount = static_cast<uint32_t>(entry.positions.count);
+				range.firstIndex = static_cast<uint32_t>(indexTotal);
+				range.indexCount = gltfTriangleIndexCount(mode, elementCount);
+				int64_t material = primitive["material"].asInt();
+				range.materialIndex = (material >= 0 && material < int64_t(defaultMaterial)) ? uint32_t(material) : defaultMaterial;
+
+				vertexTotal += range.vertexCount;
+				indexTotal += range.indexCount;
+				if (vertexTotal > UINT32_MAX || indexTotal > UINT32_MAX)
+					throw std::runtime_error("model does not fit 32 bit indices!");
+
+				meshPrimitiveRanges[m].push_back(static_cast<uint32_t>(meshRanges.size()));
+				meshRanges.push_back(range);
+				primitives.push_back(entry);
+			}
+		}
+
+		instances.clear();
+		collectGltfInstances(gltf, meshPrimitiveRanges, instances);
+
+		vertices.assign(static_cast<size_t>(vertexTotal), Vertex{});
+		indices.resize(static_cast<size_t>(indexTotal));
+
+		auto convert = [&](size_t p) {
+			const GlbPrimitive& primitive = primitives[p];
+			const MeshRange& range = meshRanges[p];
+			const JsonValue& attributes = (*primitive.json)["attributes"];
+			Vertex* dst = vertices.data() + range.firstVertex;
+
+			copyGlbStream(primitive.positions, 3, dst, offsetof(Vertex, pos));
+
+			auto copyOptional = [&](const char* name, uint32_t components, size_t memberOffset) {
+				int64_t accessorIndex = attributes[name].asInt();
+				if (accessorIndex < 0) return false;
+				GlbAccessor accessor = resolveGlbAccessor(gltf, accessorIndex, bin, binSize);
+				if (accessor.count != range.vertexCount) throw std::runtime_error(std::string("glb : ") + name + " count mismatch");
+				copyGlbStream(accessor, components, dst, memberOffset);
+				return true;
+			};
+
+			bool hasNormals = copyOptional("NORMAL", 3, offsetof(Vertex, normal));
+			copyOptional("TEXCOORD_0", 2, offsetof(Vertex, texCoord));
+			copyOptional("TEXCOORD_1", 2, offsetof(Vertex, texCoord1));
+			copyOptional("TANGENT", 4, offsetof(Vertex, tangent));
+
+			uint32_t* out = indices.data() + range.firstIndex;
+			const uint32_t base = range.firstVertex;
+			auto element = [&](size_t i) -> uint32_t {
+				uint32_t index = primitive.indexed ? readGltfIndex(primitive.indices, i) : static_cast<uint32_t>(i);
+				if (index >= range.vertexCount) throw std::runtime_error("glb : index out of range");
+				return base + index;
+			};
+
+			if (primitive.mode == GLTF_TRIANGLES) {
+				for (uint32_t i = 0; i < range.indexCount; ++i) out[i] = element(i);
+			}
+			else {
+				for (uint32_t t = 0; t < range.indexCount / 3; ++t) {
+					uint32_t a, b, c;
+					if (primitive.mode == GLTF_TRIANGLE_FAN) { a = element(0); b = element(t + 1); c = element(t + 2); }
+					// odd strip triangles swap so the winding stays consistent
+					else if (t % 2 == 0) { a = element(t); b = element(t + 1); c = element(t + 2); }
+					else { a = element(t + 1); b = element(t); c = element(t + 2); }
+					out[t * 3] = a; out[t * 3 + 1] = b; out[t * 3 + 2] = c;
+				}
+			}
+
+			if (!hasNormals) generateGlbNormals(dst, range.vertexCount, out, range.indexCount, base);
+		};
+
+		if (pool) pool->parallelFor(primitives.size(), convert);
+		else for (size_t p = 0; p < primitives.size(); ++p) convert(p);
+	}
+}
+
+#endif
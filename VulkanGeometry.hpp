@@ -5,48 +5,435 @@
 
 namespace VkApplication {
 
-	void MainVulkApplication::loadModel() {
+	// vertices / faces handed to a worker at once, big meshes are split so a single huge mesh still spreads over the pool
+	constexpr uint32_t MESH_CONVERT_CHUNK = 1u << 16;
 
-		Assimp::Importer importer;
-		const aiScene* scene = importer.ReadFile(MODEL_PATH,
-			aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_JoinIdenticalVertices | aiProcess_GenNormals);
+	// Triangulate leaves points and lines alone, only triangles end up in the index buffer
+	uint32_t countTriangleIndices(const aiMesh* mesh) {
+		if (mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE) return mesh->mNumFaces * 3;
 
-		if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
-			std::cerr << "Assimp Error: " << importer.GetErrorString() << std::endl;
-			return;
+		uint32_t count = 0;
+		for (unsigned int j = 0; j < mesh->mNumFaces; ++j)
+			if (mesh->mFaces[j].mNumIndices == 3) count += 3;
+		return count;
+	}
+
+	/*
+	Flattens every aiMesh into one global vertex / index array.
+	The arrays are sized once from the per mesh counts, then each mesh (or chunk of a big mesh) is converted straight
+	into its own slice, so workers never touch the same memory and nothing reallocates.
+	Indices are rebased by the mesh's first vertex so they address the global vertex array.
+	pool == nullptr converts on the calling thread.
+	*/
+	void convertSceneMeshes(const aiScene* scene, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices,
+		std::vector<MeshRange>& meshRanges, ThreadPool* pool) {
+
+		meshRanges.resize(scene->mNumMeshes);
+
+		uint64_t vertexTotal = 0, indexTotal = 0;
+		for (unsigned int i = 0; i < scene->mNumMeshes; ++i) {
+			const aiMesh* mesh = scene->mMeshes[i];
+			MeshRange& range = meshRanges[i];
+			range.firstVertex = static_cast<uint32_t>(vertexTotal);
+			range.vertexCount = mesh->mNumVertices;
+			range.firstIndex = static_cast<uint32_t>(indexTotal);
+			range.indexCount = countTriangleIndices(mesh);
+			range.materialIndex = mesh->mMaterialIndex;
+			vertexTotal += range.vertexCount;
+			indexTotal += range.indexCount;
 		}
 
+		if (vertexTotal > UINT32_MAX || indexTotal > UINT32_MAX)
+			throw std::runtime_error("model does not fit 32 bit indices!");
 
+		vertices.resize(static_cast<size_t>(vertexTotal));
+		indices.resize(static_cast<size_t>(indexTotal));
 
-		for (size_t i = 0; i < scene->mNumMeshes; ++i) {
+		struct ConvertTask {
+			uint32_t mesh;
+			bool faces;
+			uint32_t begin;
+			uint32_t end;
+		};
 
-			aiMesh* mesh = scene->mMeshes[i];
+		std::vector<ConvertTask> tasks;
+		for (unsigned int i = 0; i < scene->mNumMeshes; ++i) {
+			const aiMesh* mesh = scene->mMeshes[i];
 
-			for (size_t j = 0; j < mesh->mNumVertices; ++j) {
-				Vertex vertex = {};
+			for (uint32_t b = 0; b < mesh->mNumVertices; b += MESH_CONVERT_CHUNK)
+				tasks.push_back({ i, false, b, std::min(b + MESH_CONVERT_CHUNK, mesh->mNumVertices) });
 
-				vertex.pos = { mesh->mVertices[j].x, mesh->mVertices[j].y, mesh->mVertices[j].z };
+			// face j of a pure triangle mesh always lands at index 3 * j, mixed meshes need a running cursor so stay whole
+			if (mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE) {
+				for (uint32_t b = 0; b < mesh->mNumFaces; b += MESH_CONVERT_CHUNK)
+					tasks.push_back({ i, true, b, std::min(b + MESH_CONVERT_CHUNK, mesh->mNumFaces) });
+			}
+			else if (meshRanges[i].indexCount > 0) tasks.push_back({ i, true, 0, mesh->mNumFaces });
+		}
+
+		auto convert = [&](size_t t) {
+			const ConvertTask& task = tasks[t];
+			const aiMesh* mesh = scene->mMeshes[task.mesh];
+			const MeshRange& range = meshRanges[task.mesh];
 
-				if (mesh->HasNormals()) 
-					vertex.normal = { mesh->mNormals[j].x, mesh->mNormals[j].y, mesh->mNormals[j].z };
+			if (!task.faces) {
+				Vertex* dst = vertices.data() + range.firstVertex;
+				for (uint32_t j = task.begin; j < task.end; ++j) {
+					Vertex vertex = {};
 
-				if (mesh->HasTextureCoords(0))
-					vertex.texCoord = { mesh->mTextureCoords[0][j].x, mesh->mTextureCoords[0][j].y };
-				else vertex.texCoord = { 0.0f, 0.0f };
+					vertex.pos = { mesh->mVertices[j].x, mesh->mVertices[j].y, mesh->mVertices[j].z };
 
-				vertices.push_back(vertex);
+					if (mesh->HasNormals())
+						vertex.normal = { mesh->mNormals[j].x, mesh->mNormals[j].y, mesh->mNormals[j].z };
+
+					if (mesh->HasTextureCoords(0))
+						vertex.texCoord = { mesh->mTextureCoords[0][j].x, mesh->mTextureCoords[0][j].y };
+					else vertex.texCoord = { 0.0f, 0.0f };
+
+					dst[j] = vertex;
+				}
+				return;
 			}
 
-			for (size_t j = 0; j < mesh->mNumFaces; j++) {
-				aiFace face = mesh->mFaces[j];
-				for (size_t k = 0; k < face.mNumIndices; k++) {
-					indices.push_back(face.mIndices[k]);
+			uint32_t* dst = indices.data() + range.firstIndex;
+			uint32_t cursor = task.begin * 3;
+			for (uint32_t j = task.begin; j < task.end; ++j) {
+				const aiFace& face = mesh->mFaces[j];
+				if (face.mNumIndices != 3) continue;
+				dst[cursor++] = range.firstVertex + face.mIndices[0];
+				dst[cursor++] = range.firstVertex + face.mIndices[1];
+				dst[cursor++] = range.firstVertex + face.mIndices[2];
+			}
+		};
+
+		if (pool) pool->parallelFor(tasks.size(), convert);
+		else for (size_t t = 0; t < tasks.size(); ++t) convert(t);
+	}
+
+	void convertSceneMaterials(const aiScene* scene, std::vector<Material>& materials) {
+		// meshes always carry a material index, keep a default entry even for scenes without materials
+		materials.assign(std::max(1u, scene->mNumMaterials), Material{});
+
+		for (unsigned int i = 0; i < scene->mNumMaterials; ++i) {
+			const aiMaterial* aiMat = scene->mMaterials[i];
+			Material& material = materials[i];
+
+			aiColor4D color(1.0f, 1.0f, 1.0f, 1.0f);
+			if (aiMat->Get(AI_MATKEY_BASE_COLOR, color) != AI_SUCCESS)
+				aiMat->Get(AI_MATKEY_COLOR_DIFFUSE, color);
+			material.basecolor = glm::vec4(color.r, color.g, color.b, color.a);
+
+			ai_real factor;
+			if (aiMat->Get(AI_MATKEY_METALLIC_FACTOR, factor) == AI_SUCCESS) material.metallicFactor = factor;
+			if (aiMat->Get(AI_MATKEY_ROUGHNESS_FACTOR, factor) == AI_SUCCESS) material.roughnessFactor = factor;
+		}
+	}
+
+	// accumulated node transforms, one MeshInstance per mesh reference of every node
+	// a node under an animated one is rigid, a mesh with bones or anim meshes deforming
+	void collectSceneInstances(const aiScene* scene, std::vector<MeshInstance>& instances) {
+		instances.clear();
+		if (!scene->mRootNode) return;
+
+		std::unordered_set<std::string> animatedNodes;
+		for (unsigned int a = 0; a < scene->mNumAnimations; ++a)
+			for (unsigned int c = 0; c < scene->mAnimations[a]->mNumChannels; ++c)
+				animatedNodes.insert(scene->mAnimations[a]->mChannels[c]->mNodeName.C_Str());
+
+		struct Visit { const aiNode* node; glm::mat4 parent; bool animated; };
+		std::vector<Visit> stack = { { scene->mRootNode, glm::mat4(1.0f), false } };
+		while (!stack.empty()) {
+			auto [node, parent, animatedParent] = stack.back();
+			stack.pop_back();
+
+			// aiMatrix4x4 is row major, glm takes columns
+			const aiMatrix4x4& m = node->mTransformation;
+			const glm::mat4 local(m.a1, m.b1, m.c1, m.d1, m.a2, m.b2, m.c2, m.d2, m.a3, m.b3, m.c3, m.d3, m.a4, m.b4, m.c4, m.d4);
+			const glm::mat4 world = parent * local;
+			const bool animated = animatedParent || animatedNodes.count(node->mName.C_Str()) != 0;
+
+			for (unsigned int i = 0; i < node->mNumMeshes; ++i) {
+				const aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
+				MeshInstance instance;
+				instance.transform = world;
+				instance.mesh = node->mMeshes[i];
+				ObjectMotion motion = animated ? ObjectMotion::Rigid : ObjectMotion::Static;
+				if (mesh->HasBones() || mesh->mNumAnimMeshes > 0) motion = ObjectMotion::Deforming;
+				instance.motion = static_cast<uint32_t>(motion);
+				instances.push_back(instance);
+			}
+			for (unsigned int c = node->mNumChildren; c-- > 0;) stack.push_back({ node->mChildren[c], world, animated });
+		}
+	}
+
+	/*
+	Folds meshes with identical content (vertices, mesh local indices, material) into one, whether the copies came
+	from separate aiMeshes, separate glTF meshes or separate files merged into one scene. Instances are remapped to
+	the surviving mesh and the vertex / index arrays are compacted, so every copy after the first costs one
+	TLAS instance instead of its geometry and BLAS. Candidates are bucketed by hash and confirmed byte for byte.
+	*/
+	void deduplicateMeshes(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<MeshRange>& meshRanges,
+		std::vector<MeshInstance>& instances, ThreadPool* pool) {
+
+		using std::cout; using std::endl;
+		auto startTime = std::chrono::high_resolution_clock::now();
+
+		// indices hashed relative to the mesh's first vertex, identical meshes sit at different offsets
+		std::vector<uint64_t> hashes(meshRanges.size());
+		auto hashMesh = [&](size_t m) {
+			const MeshRange& range = meshRanges[m];
+			uint64_t hash = hashBytes(reinterpret_cast<const uint8_t*>(vertices.data() + range.firstVertex), range.vertexCount * sizeof(Vertex));
+			std::vector<uint32_t> local(indices.begin() + range.firstIndex, indices.begin() + range.firstIndex + range.indexCount);
+			for (uint32_t& index : local) index -= range.firstVertex;
+			hash = hashBytes(reinterpret_cast<const uint8_t*>(local.data()), local.size() * sizeof(uint32_t), hash);
+			hashes[m] = hashBytes(reinterpret_cast<const uint8_t*>(&range.materialIndex), sizeof(uint32_t), hash);
+		};
+		if (pool) pool->parallelFor(meshRanges.size(), hashMesh);
+		else for (size_t m = 0; m < meshRanges.size(); ++m) hashMesh(m);
+
+		auto sameContent = [&](const MeshRange& a, const MeshRange& b) {
+			if (a.vertexCount != b.vertexCount || a.indexCount != b.indexCount || a.materialIndex != b.materialIndex) return false;
+			if (memcmp(vertices.data() + a.firstVertex, vertices.data() + b.firstVertex, a.vertexCount * sizeof(Vertex)) != 0) return false;
+			for (uint32_t i = 0; i < a.indexCount; ++i)
+				if (indices[a.firstIndex + i] - a.firstVertex != indices[b.firstIndex + i] - b.firstVertex) return false;
+			return true;
+		};
+
+		std::unordered_map<uint64_t, std::vector<uint32_t>> buckets;
+		std::vector<uint32_t> canonical(meshRanges.size());
+		size_t duplicates = 0;
+		for (uint32_t m = 0; m < meshRanges.size(); ++m) {
+			canonical[m] = m;
+			for (uint32_t candidate : buckets[hashes[m]]) {
+				if (sameContent(meshRanges[candidate], meshRanges[m])) {
+					canonical[m] = candidate;
+					duplicates++;
+					break;
 				}
 			}
+			if (canonical[m] == m) buckets[hashes[m]].push_back(m);
+		}
+		if (duplicates == 0) return;
+
+		// compact the unique meshes in their original order
+		std::vector<uint32_t> newIndex(meshRanges.size(), UINT32_MAX);
+		std::vector<MeshRange> uniqueRanges;
+		std::vector<Vertex> uniqueVertices;
+		std::vector<uint32_t> uniqueIndices;
+		for (uint32_t m = 0; m < meshRanges.size(); ++m) {
+			if (canonical[m] != m) continue;
+			const MeshRange& range = meshRanges[m];
+			MeshRange compacted = range;
+			compacted.firstVertex = static_cast<uint32_t>(uniqueVertices.size());
+			compacted.firstIndex = static_cast<uint32_t>(uniqueIndices.size());
+			uniqueVertices.insert(uniqueVertices.end(), vertices.begin() + range.firstVertex, vertices.begin() + range.firstVertex + range.vertexCount);
+			for (uint32_t i = 0; i < range.indexCount; ++i)
+				uniqueIndices.push_back(indices[range.firstIndex + i] - range.firstVertex + compacted.firstVertex);
+			newIndex[m] = static_cast<uint32_t>(uniqueRanges.size());
+			uniqueRanges.push_back(compacted);
+		}
+		for (MeshInstance& instance : instances) instance.mesh = newIndex[canonical[instance.mesh]];
+
+		const double mb = 1.0 / (1024.0 * 1024.0);
+		const size_t savedBytes = (vertices.size() - uniqueVertices.size()) * sizeof(Vertex) + (indices.size() - uniqueIndices.size()) * sizeof(uint32_t);
+		cout << "dedupe : " << meshRanges.size() << " meshes -> " << uniqueRanges.size() << " unique, "
+			<< savedBytes * mb << " MB of geometry saved in " << elapsedMs(startTime, std::chrono::high_resolution_clock::now()) << " ms" << endl;
+
+		vertices.swap(uniqueVertices);
+		indices.swap(uniqueIndices);
+		meshRanges.swap(uniqueRanges);
+	}
+
+	bool hasExtension(const std::string& path, const char* extension) {
+		size_t length = strlen(extension);
+		if (path.size() < length) return false;
+		return std::equal(path.end() - length, path.end(), extension,
+			[](char a, char b) { return tolower(static_cast<unsigned char>(a)) == tolower(static_cast<unsigned char>(b)); });
+	}
+
+	void MainVulkApplication::loadModel() {
+
+		using std::cout; using std::endl;
+		auto startTime = std::chrono::high_resolution_clock::now();
 
+		const bool nativeGLB = loadOptions.nativeGLB && hasExtension(MODEL_PATH, ".glb");
+		const uint32_t processFlags = (nativeGLB ? SCENE_PROCESS_NATIVE_GLB : 0) |
+			(loadOptions.optimizeMeshes ? SCENE_PROCESS_REORDERED : 0) |
+			(loadOptions.lodLevels ? SCENE_PROCESS_LODS | (loadOptions.lodLevels << SCENE_PROCESS_LOD_LEVEL_SHIFT) : 0);
 
+		// warm start, the cooked cache replaces the whole import
+		uint64_t sourceHash = 0, sourceSize = 0;
+		bool cacheable = loadOptions.useSceneCache && hashSourceFile(MODEL_PATH, sourceHash, sourceSize);
+		auto hashTime = std::chrono::high_resolution_clock::now();
 
+		if (cacheable && loadSceneCache(sourceHash, sourceSize, processFlags)) {
+			cout << "Model : " << MODEL_PATH << " from " << sceneCachePath(MODEL_PATH) << " (" << meshRanges.size() << " meshes, "
+				<< meshInstances.size() << " instances, " << geometry.vertexCount << " vertices, " << sceneIndexCount() / 3 << " triangles)" << endl;
+			cout << "\thash     : " << elapsedMs(startTime, hashTime) << " ms" << endl;
+			cout << "\tmap      : " << elapsedMs(hashTime, std::chrono::high_resolution_clock::now()) << " ms" << endl;
+			return;
+		}
+
+		if (!workerPool) workerPool = std::make_unique<ThreadPool>();
+
+		bool loaded = false;
+		if (nativeGLB) {
+			try {
+				loadGLBModel(MODEL_PATH, vertices, indices, meshRanges, materials, meshInstances, workerPool.get());
+				loaded = true;
+			}
+			catch (const std::exception& e) {
+				std::cerr << e.what() << ", falling back to Assimp" << std::endl;
+			}
+		}
+		auto importTime = std::chrono::high_resolution_clock::now();
+
+		if (!loaded) {
+			Assimp::Importer importer;
+			const aiScene* scene = importer.ReadFile(MODEL_PATH, MODEL_IMPORT_FLAGS);
+
+			if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+				std::cerr << "Assimp Error: " << importer.GetErrorString() << std::endl;
+				return;
+			}
+
+			importTime = std::chrono::high_resolution_clock::now();
+			convertSceneMeshes(scene, vertices, indices, meshRanges, workerPool.get());
+			convertSceneMaterials(scene, materials);
+			collectSceneInstances(scene, meshInstances);
+		}
+
+		// a scene without a node graph still places every mesh once
+		if (meshInstances.empty()) {
+			meshInstances.resize(meshRanges.size());
+			for (uint32_t m = 0; m < meshRanges.size(); ++m) meshInstances[m].mesh = m;
+		}
+
+		auto convertTime = std::chrono::high_resolution_clock::now();
+
+		// before the reorder and LODs so copies are only processed once, reports its own timing
+		deduplicateMeshes(vertices, indices, meshRanges, meshInstances, workerPool.get());
+
+		// reports its own timing and metrics
+		if (loadOptions.optimizeMeshes) optimizeMeshOrder(vertices, indices, meshRanges, workerPool.get());
+		// after the reorder, levels index the final vertex order
+		meshLods.clear();
+		if (loadOptions.lodLevels) generateMeshLods(vertices, indices, meshRanges, meshLods, loadOptions.lodLevels, workerPool.get());
+
+		geometry.vertices = vertices.data();
+		geometry.vertexCount = vertices.size();
+		geometry.indices = indices.data();
+		geometry.indexCount = indices.size();
+
+		auto cacheTime = std::chrono::high_resolution_clock::now();
+
+		// keyed on what was asked for, a fallback for the same bytes is just as deterministic
+		if (cacheable) writeSceneCache(sourceHash, sourceSize, processFlags);
+
+		cout << "Model : " << MODEL_PATH << " (" << meshRanges.size() << " meshes, "
+			<< meshInstances.size() << " instances, " << vertices.size() << " vertices, " << sceneIndexCount() / 3 << " triangles)" << endl;
+		if (cacheable) cout << "\thash     : " << elapsedMs(startTime, hashTime) << " ms" << endl;
+		if (loaded) cout << "\tglb      : " << elapsedMs(hashTime, importTime) << " ms on " << workerPool->size() << " threads" << endl;
+		else {
+			cout << "\tReadFile : " << elapsedMs(hashTime, importTime) << " ms" << endl;
+			cout << "\tconvert  : " << elapsedMs(importTime, convertTime) << " ms on " << workerPool->size() << " threads" << endl;
+		}
+		if (cacheable) cout << "\tcache    : " << elapsedMs(cacheTime, std::chrono::high_resolution_clock::now()) << " ms" << endl;
+	}
+
+	/*
+	Kicks off loadModel on its own thread: file parse, conversion, dedupe, reorder, LODs and the scene cache all
+	run on the cpu while the main thread creates the window, instance, device, swapchain and pipelines.
+	Until waitForAssets the loader owns vertices / indices / meshRanges / materials / geometry, nothing on the
+	main thread may touch them. The worker pool is created up front so both sides never race on it.
+	*/
+	void MainVulkApplication::startAssetLoad() {
+		if (!workerPool) workerPool = std::make_unique<ThreadPool>();
+		if (!loadOptions.asyncLoad) return;
+
+		assetLoadStart = std::chrono::high_resolution_clock::now();
+		assetLoad = std::async(std::launch::async, [this] {
+			loadModel();
+			assetLoadEnd = std::chrono::high_resolution_clock::now();
+		});
+	}
+
+	// first consumer of the cpu geometry joins the loader, load errors are rethrown here
+	void MainVulkApplication::waitForAssets() {
+		if (!assetLoad.valid()) {
+			loadModel();
+			return;
+		}
+
+		auto waitStart = std::chrono::high_resolution_clock::now();
+		assetLoad.get();
+		auto waitEnd = std::chrono::high_resolution_clock::now();
+
+		const double loadMs = elapsedMs(assetLoadStart, assetLoadEnd);
+		const double waitMs = elapsedMs(waitStart, waitEnd);
+		std::cout << "assets : loaded in " << loadMs << " ms, " << std::max(0.0, loadMs - waitMs)
+			<< " ms hidden behind vulkan init, main thread waited " << waitMs << " ms" << std::endl;
+	}
+
+	// one SceneObject per referenced mesh with its LOD chain, MeshInfo entries follow buildMeshInfos (meshes, then meshLods)
+	// every MeshInstance becomes a SceneInstance of its mesh's object, unreferenced meshes never get a BLAS
+	void MainVulkApplication::buildSceneObjects() {
+		scene.objects.clear();
+		scene.instances.clear();
+
+		std::vector<uint32_t> references(meshRanges.size(), 0);
+		for (const MeshInstance& instance : meshInstances) references[instance.mesh]++;
+
+		std::vector<uint64_t> objectIds(meshRanges.size(), 0);
+		size_t nextLod = 0; // meshLods are sorted by mesh
+		for (uint32_t m = 0; m < meshRanges.size(); ++m) {
+			SceneObject object;
+			object.name = "mesh " + std::to_string(m);
+			object.id = std::hash<std::string>{}(object.name);
+			object.range = meshRanges[m];
+			object.geometryIndex = m;
+			object.material = materials[std::min<size_t>(meshRanges[m].materialIndex, materials.size() - 1)];
+			object.transform = glm::mat4(1.0f);
+
+			const MeshInfo& info = meshInfos[m];
+			const glm::vec3 extent = info.boundsScale * QUANTIZE_MAX;
+			object.boundsCenter = info.boundsMin + extent * 0.5f;
+			object.boundsRadius = glm::length(extent) * 0.5f;
+
+			LodLevel base;
+			base.firstIndex = meshRanges[m].firstIndex;
+			base.indexCount = meshRanges[m].indexCount;
+			base.meshInfoIndex = m;
+			object.lods.push_back(base);
+			for (; nextLod < meshLods.size() && meshLods[nextLod].mesh == m; ++nextLod) {
+				LodLevel level;
+				level.firstIndex = meshLods[nextLod].firstIndex;
+				level.indexCount = meshLods[nextLod].indexCount;
+				level.meshInfoIndex = static_cast<uint32_t>(meshRanges.size() + nextLod);
+				object.lods.push_back(level);
+			}
+
+			if (references[m] == 0 || meshRanges[m].indexCount == 0) continue;
+
+			// views into the shared buffers, the app owns and frees the real ones
+			object.vertexBuffer.buffer = vertexBuffer;
+			object.vertexBuffer.setupDescriptor(VK_WHOLE_SIZE, 0);
+			object.indexBuffer.buffer = indexBuffer;
+			object.indexBuffer.setupDescriptor(meshRanges[m].indexCount * sizeof(uint32_t), meshRanges[m].firstIndex * sizeof(uint32_t));
+
+			objectIds[m] = object.id;
+			scene.addObject(object);
 		}
+
+		for (const MeshInstance& instance : meshInstances) {
+			if (objectIds[instance.mesh] == 0) continue;
+			scene.addInstance(objectIds[instance.mesh], instance.transform);
+			// an object deforms or moves as soon as one of its placements does
+			SceneObject& object = scene.objects.at(objectIds[instance.mesh]);
+			object.motion = std::max(object.motion, static_cast<ObjectMotion>(std::min<uint32_t>(instance.motion, uint32_t(ObjectMotion::Deforming))));
+		}
+
+		std::cout << "scene : " << scene.objects.size() << " objects, " << scene.instances.size() << " instances" << std::endl;
 	}
 }
-#endif
\ No newline at end of file
+#endif
@@ -281,6 +281,7 @@ namespace VkApplication {
 			//ImGui::End();
 		}
 		ImGui::End();
+		drawMemoryPanel();
 		// Rendering
 		ImGui::Render();
 		/*
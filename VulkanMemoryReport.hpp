@@ -0,0 +1,155 @@
+#ifndef __VK_MEMORY_REPORT_HPP__
+#define __VK_MEMORY_REPORT_HPP__
+
+/*
+GPU memory accounting, per category from the MMM module and per heap from the driver.
+
+	categories  live bytes as charged to each allocation, pool sub-allocations and dedicated image memory
+	heaps       what memoryManager holds from each heap (blocks + dedicated), against the driver's usage and budget
+
+Budget and usage come from VK_EXT_memory_budget, without it only the heap size is known. The driver's usage covers the
+whole process (swapchain, imgui, driver internals), the difference to our own figure is memory we do not allocate.
+Anything that should have been freed stays visible as live bytes, the build scratch pool is kept on purpose.
+*/
+
+namespace VkApplication {
+
+	// lives in the frame arena, the panel asks every frame
+	FrameVector<HeapBudget> MainVulkApplication::queryHeapBudgets() {
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+		budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+		VkPhysicalDeviceMemoryProperties2 memoryProperties2{};
+		memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+		if (memoryBudgetSupported) memoryProperties2.pNext = &budgetProperties;
+		vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &memoryProperties2);
+
+		const VkPhysicalDeviceMemoryProperties& properties = memoryProperties2.memoryProperties;
+		const auto allocated = memoryManager.getHeapUsage();
+
+		FrameVector<HeapBudget> heaps(properties.memoryHeapCount, HeapBudget{}, FrameAllocator<HeapBudget>(frameArena()));
+		for (uint32_t h = 0; h < properties.memoryHeapCount; ++h) {
+			heaps[h].size = properties.memoryHeaps[h].size;
+			heaps[h].deviceLocal = (properties.memoryHeaps[h].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+			heaps[h].allocated = allocated[h];
+			if (memoryBudgetSupported) {
+				heaps[h].budget = budgetProperties.heapBudget[h];
+				heaps[h].usage = budgetProperties.heapUsage[h];
+			}
+		}
+		return heaps;
+	}
+
+	void MainVulkApplication::drawMemoryPanel() {
+		if (!showMemoryPanel) return;
+		const double mb = 1.0 / (1024.0 * 1024.0);
+
+		ImGui::Begin("GPU memory", &showMemoryPanel);
+
+		const auto categories = memoryManager.getCategoryStats();
+		VkDeviceSize total = 0;
+		if (ImGui::BeginTable("categories", 4, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp)) {
+			ImGui::TableSetupColumn("category");
+			ImGui::TableSetupColumn("live");
+			ImGui::TableSetupColumn("MB");
+			ImGui::TableSetupColumn("peak MB");
+			ImGui::TableHeadersRow();
+			for (uint32_t c = 0; c < static_cast<uint32_t>(MemoryCategory::Count); ++c) {
+				const MemoryCategoryStats& entry = categories[c];
+				total += entry.bytes;
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn(); ImGui::TextUnformatted(memoryCategoryName(static_cast<MemoryCategory>(c)));
+				ImGui::TableNextColumn(); ImGui::Text("%llu", static_cast<unsigned long long>(entry.liveAllocations));
+				ImGui::TableNextColumn(); ImGui::Text("%.2f", entry.bytes * mb);
+				ImGui::TableNextColumn(); ImGui::Text("%.2f", entry.peakBytes * mb);
+			}
+			ImGui::EndTable();
+		}
+
+		const MemoryPoolStats stats = memoryManager.getStats();
+		ImGui::Text("%.2f MB live, pools %.2f MB reserved in %llu blocks", total * mb, stats.reservedBytes * mb,
+			static_cast<unsigned long long>(stats.blocks));
+
+		ImGui::Separator();
+		const FrameVector<HeapBudget> heaps = queryHeapBudgets();
+		for (size_t h = 0; h < heaps.size(); ++h) {
+			const HeapBudget& heap = heaps[h];
+			if (memoryBudgetSupported) {
+				ImGui::Text("heap %zu%s : %.1f / %.1f MB budget (ours %.1f MB, heap %.0f MB)", h, heap.deviceLocal ? " device" : "",
+					heap.usage * mb, heap.budget * mb, heap.allocated * mb, heap.size * mb);
+				ImGui::ProgressBar(heap.budget ? static_cast<float>(double(heap.usage) / double(heap.budget)) : 0.0f);
+			}
+			else ImGui::Text("heap %zu%s : ours %.1f MB of %.0f MB", h, heap.deviceLocal ? " device" : "", heap.allocated * mb, heap.size * mb);
+		}
+		if (!memoryBudgetSupported) ImGui::TextUnformatted("VK_EXT_memory_budget not supported");
+
+		ImGui::Separator();
+		ImGui::Checkbox("defragment", &defragEnabled);
+		int defragMB = static_cast<int>(defragBytesPerFrame >> 20);
+		if (ImGui::SliderInt("MB / frame", &defragMB, 1, 256)) defragBytesPerFrame = static_cast<VkDeviceSize>(defragMB) << 20;
+		ImGui::Text("%llu passes, %llu moves, %.2f MB moved, %llu stalls", static_cast<unsigned long long>(defragStats.passes),
+			static_cast<unsigned long long>(defragStats.moves), defragStats.movedBytes * mb, static_cast<unsigned long long>(defragStats.stalls));
+
+		ImGui::Text("frame arena : %.1f KB, peak %.1f KB, %llu grows", frameArena().size() / 1024.0, frameArena().peakBytes() / 1024.0,
+			static_cast<unsigned long long>(frameArena().growCount()));
+
+		ImGui::Separator();
+		int refitLimit = static_cast<int>(loadOptions.tlasRefitLimit);
+		if (ImGui::SliderInt("TLAS refits / build", &refitLimit, 0, 256)) loadOptions.tlasRefitLimit = static_cast<uint32_t>(refitLimit);
+		int animated = static_cast<int>(animatedInstances);
+		if (ImGui::SliderInt("animated instances", &animated, 0, static_cast<int>(scene.instances.size())))
+			animatedInstances = static_cast<uint32_t>(animated);
+		ImGui::Text("TLAS : %llu builds, %llu refits, %llu reallocations, last %.3f ms gpu, %.3f ms cpu",
+			static_cast<unsigned long long>(tlasStats.builds), static_cast<unsigned long long>(tlasStats.refits),
+			static_cast<unsigned long long>(tlasStats.reallocations), tlasStats.gpuMs, tlasStats.cpuMs);
+
+		int blasRefitLimit = static_cast<int>(loadOptions.blasRefitLimit);
+		if (ImGui::SliderInt("BLAS refits / build", &blasRefitLimit, 0, 256)) loadOptions.blasRefitLimit = static_cast<uint32_t>(blasRefitLimit);
+		int updatable = 0;
+		for (const auto& entry : scene.objects) if (asBuildRefits(entry.second.buildPolicy)) updatable++;
+		int deformed = static_cast<int>(deformedObjects);
+		if (ImGui::SliderInt("deformed objects", &deformed, 0, updatable)) deformedObjects = static_cast<uint32_t>(deformed);
+		ImGui::Text("BLAS updates : %llu refits, %llu rebuilds, last %.3f ms", static_cast<unsigned long long>(blasUpdateStats.refits),
+			static_cast<unsigned long long>(blasUpdateStats.rebuilds), blasUpdateStats.lastMs);
+
+		if (ImGui::Button("Dump JSON")) dumpMemoryReport("memory_report.json");
+		ImGui::End();
+	}
+
+	// same numbers as the panel, for diffing runs
+	void MainVulkApplication::dumpMemoryReport(const std::string& path) {
+		std::ofstream out(path);
+		if (!out) {
+			std::cerr << "memory report : could not open " << path << std::endl;
+			return;
+		}
+
+		const auto categories = memoryManager.getCategoryStats();
+		const MemoryPoolStats stats = memoryManager.getStats();
+		const FrameVector<HeapBudget> heaps = queryHeapBudgets();
+
+		out << "{\n\t\"categories\": {\n";
+		for (uint32_t c = 0; c < static_cast<uint32_t>(MemoryCategory::Count); ++c) {
+			const MemoryCategoryStats& entry = categories[c];
+			out << "\t\t\"" << memoryCategoryName(static_cast<MemoryCategory>(c)) << "\": { \"live\": " << entry.liveAllocations
+				<< ", \"allocations\": " << entry.totalAllocations << ", \"bytes\": " << entry.bytes
+				<< ", \"peakBytes\": " << entry.peakBytes << " }" << (c + 1 < static_cast<uint32_t>(MemoryCategory::Count) ? ",\n" : "\n");
+		}
+		out << "\t},\n\t\"pools\": { \"blocks\": " << stats.blocks << ", \"deviceAllocations\": " << stats.deviceAllocations
+			<< ", \"reservedBytes\": " << stats.reservedBytes << ", \"usedBytes\": " << stats.usedBytes
+			<< ", \"allocations\": " << stats.allocations << ", \"frees\": " << stats.frees << " },\n";
+		out << "\t\"defrag\": { \"passes\": " << defragStats.passes << ", \"moves\": " << defragStats.moves
+			<< ", \"movedBytes\": " << defragStats.movedBytes << ", \"stalls\": " << defragStats.stalls << " },\n";
+		out << "\t\"memoryBudget\": " << (memoryBudgetSupported ? "true" : "false") << ",\n\t\"heaps\": [\n";
+		for (size_t h = 0; h < heaps.size(); ++h) {
+			const HeapBudget& heap = heaps[h];
+			out << "\t\t{ \"deviceLocal\": " << (heap.deviceLocal ? "true" : "false") << ", \"size\": " << heap.size
+				<< ", \"budget\": " << heap.budget << ", \"usage\": " << heap.usage << ", \"allocated\": " << heap.allocated << " }"
+				<< (h + 1 < heaps.size() ? ",\n" : "\n");
+		}
+		out << "\t]\n}\n";
+		std::cout << "memory report : written to " << path << std::endl;
+	}
+}
+
+#endif
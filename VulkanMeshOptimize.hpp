@@ -0,0 +1,158 @@
+#ifndef __VK_MESH_OPTIMIZE_HPP__
+#define __VK_MESH_OPTIMIZE_HPP__
+
+/*
+Optional reordering pass between import and upload, SceneLoadOptions::optimizeMeshes.
+Every mesh is reordered inside its own MeshRange so ranges, materials and the cache layout stay untouched:
+
+	1. triangles sorted along a 63 bit Morton curve of their centroids
+	2. vertices renumbered in first use order of the sorted triangles
+	3. indices remapped to the new vertex numbering
+
+Neighbouring triangles end up close in memory and space, which is what the BLAS builder, the traversal caches and
+the closest hit vertex fetches all want. The result is cooked into the scene cache so warm starts skip it.
+*/
+
+namespace VkApplication {
+
+	constexpr uint32_t VERTEX_CACHE_SIZE = 32;
+
+	// spreads the low 21 bits of v so two zero bits sit between each of them
+	uint64_t expandBits21(uint64_t v) {
+		v &= 0x1fffff;
+		v = (v | v << 32) & 0x1f00000000ffffull;
+		v = (v | v << 16) & 0x1f0000ff0000ffull;
+		v = (v | v << 8) & 0x100f00f00f00f00full;
+		v = (v | v << 4) & 0x10c30c30c30c30c3ull;
+		v = (v | v << 2) & 0x1249249249249249ull;
+		return v;
+	}
+
+	uint64_t mortonCode(const glm::vec3& unit) {
+		const float scale = float((1u << 21) - 1);
+		glm::vec3 q = glm::clamp(unit * scale, glm::vec3(0.0f), glm::vec3(scale));
+		return expandBits21(uint64_t(q.x)) | (expandBits21(uint64_t(q.y)) << 1) | (expandBits21(uint64_t(q.z)) << 2);
+	}
+
+	// before / after numbers, summed over all meshes
+	struct MeshOrderStats {
+		uint64_t triangles = 0;
+		uint64_t cacheMisses = 0;     // FIFO post transform cache of VERTEX_CACHE_SIZE
+		double centroidStep = 0.0;    // distance between consecutive centroids, relative to the mesh diagonal
+		uint64_t indexSpan = 0;       // max - min vertex index per triangle
+
+		void add(const MeshOrderStats& other) {
+			triangles += other.triangles;
+			cacheMisses += other.cacheMisses;
+			centroidStep += other.centroidStep;
+			indexSpan += other.indexSpan;
+		}
+
+		double acmr() const { return triangles ? double(cacheMisses) / triangles : 0.0; }
+		double meanStep() const { return triangles ? centroidStep / triangles : 0.0; }
+		double meanSpan() const { return triangles ? double(indexSpan) / triangles : 0.0; }
+	};
+
+	MeshOrderStats measureMeshOrder(const Vertex* meshVertices, uint32_t vertexCount, const uint32_t* meshIndices,
+		uint32_t indexCount, uint32_t baseVertex, float invDiagonal) {
+
+		MeshOrderStats stats;
+		stats.triangles = indexCount / 3;
+
+		// a vertex is cached while fewer than VERTEX_CACHE_SIZE misses happened since it was loaded
+		std::vector<uint64_t> loadedAt(vertexCount, UINT64_MAX);
+		uint64_t misses = 0;
+		glm::vec3 previous(0.0f);
+
+		for (uint32_t i = 0; i + 2 < indexCount; i += 3) {
+			uint32_t tri[3] = { meshIndices[i] - baseVertex, meshIndices[i + 1] - baseVertex, meshIndices[i + 2] - baseVertex };
+			for (uint32_t v : tri) {
+				if (loadedAt[v] == UINT64_MAX || misses - loadedAt[v] >= VERTEX_CACHE_SIZE) loadedAt[v] = misses++;
+			}
+
+			glm::vec3 centroid = (meshVertices[tri[0]].pos + meshVertices[tri[1]].pos + meshVertices[tri[2]].pos) / 3.0f;
+			if (i > 0) stats.centroidStep += glm::length(centroid - previous) * invDiagonal;
+			previous = centroid;
+
+			stats.indexSpan += std::max({ tri[0], tri[1], tri[2] }) - std::min({ tri[0], tri[1], tri[2] });
+		}
+		stats.cacheMisses = misses;
+		return stats;
+	}
+
+	void optimizeMeshOrder(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices,
+		const std::vector<MeshRange>& meshRanges, ThreadPool* pool) {
+
+		using std::cout; using std::endl;
+		auto startTime = std::chrono::high_resolution_clock::now();
+
+		std::vector<MeshOrderStats> before(meshRanges.size()), after(meshRanges.size());
+
+		auto optimize = [&](size_t m) {
+			const MeshRange& range = meshRanges[m];
+			const uint32_t triangleCount = range.indexCount / 3;
+			if (triangleCount == 0) return;
+
+			Vertex* meshVertices = vertices.data() + range.firstVertex;
+			uint32_t* meshIndices = indices.data() + range.firstIndex;
+
+			glm::vec3 lo(std::numeric_limits<float>::max()), hi(-std::numeric_limits<float>::max());
+			for (uint32_t v = 0; v < range.vertexCount; ++v) {
+				lo = glm::min(lo, meshVertices[v].pos);
+				hi = glm::max(hi, meshVertices[v].pos);
+			}
+			const glm::vec3 extent = glm::max(hi - lo, glm::vec3(1e-20f));
+			const float invDiagonal = 1.0f / glm::length(extent);
+
+			before[m] = measureMeshOrder(meshVertices, range.vertexCount, meshIndices, range.indexCount, range.firstVertex, invDiagonal);
+
+			// 1. triangles along the Morton curve
+			std::vector<std::pair<uint64_t, uint32_t>> keys(triangleCount);
+			for (uint32_t t = 0; t < triangleCount; ++t) {
+				const uint32_t* tri = meshIndices + t * 3;
+				glm::vec3 centroid = (meshVertices[tri[0] - range.firstVertex].pos + meshVertices[tri[1] - range.firstVertex].pos +
+					meshVertices[tri[2] - range.firstVertex].pos) / 3.0f;
+				keys[t] = { mortonCode((centroid - lo) / extent), t };
+			}
+			std::sort(keys.begin(), keys.end());
+
+			std::vector<uint32_t> sortedIndices(triangleCount * 3);
+			for (uint32_t t = 0; t < triangleCount; ++t)
+				memcpy(&sortedIndices[t * 3], meshIndices + keys[t].second * 3, 3 * sizeof(uint32_t));
+
+			// 2. vertices in first use order, unreferenced ones keep their relative order at the end
+			std::vector<uint32_t> remap(range.vertexCount, UINT32_MAX);
+			uint32_t next = 0;
+			for (uint32_t index : sortedIndices)
+				if (remap[index - range.firstVertex] == UINT32_MAX) remap[index - range.firstVertex] = next++;
+			for (uint32_t v = 0; v < range.vertexCount; ++v)
+				if (remap[v] == UINT32_MAX) remap[v] = next++;
+
+			std::vector<Vertex> sortedVertices(range.vertexCount);
+			for (uint32_t v = 0; v < range.vertexCount; ++v) sortedVertices[remap[v]] = meshVertices[v];
+			std::copy(sortedVertices.begin(), sortedVertices.end(), meshVertices);
+
+			// 3. indices into the new numbering, still offset by the mesh's first vertex
+			for (uint32_t i = 0; i < triangleCount * 3; ++i)
+				meshIndices[i] = range.firstVertex + remap[sortedIndices[i] - range.firstVertex];
+
+			after[m] = measureMeshOrder(meshVertices, range.vertexCount, meshIndices, range.indexCount, range.firstVertex, invDiagonal);
+		};
+
+		if (pool) pool->parallelFor(meshRanges.size(), optimize);
+		else for (size_t m = 0; m < meshRanges.size(); ++m) optimize(m);
+
+		MeshOrderStats totalBefore, totalAfter;
+		for (size_t m = 0; m < meshRanges.size(); ++m) {
+			totalBefore.add(before[m]);
+			totalAfter.add(after[m]);
+		}
+
+		cout << "mesh reorder : " << elapsedMs(startTime, std::chrono::high_resolution_clock::now()) << " ms" << endl;
+		cout << "\tACMR (fifo " << VERTEX_CACHE_SIZE << ")  : " << totalBefore.acmr() << " -> " << totalAfter.acmr() << endl;
+		cout << "\tcentroid step    : " << totalBefore.meanStep() << " -> " << totalAfter.meanStep() << " of mesh diagonal" << endl;
+		cout << "\tindex span       : " << totalBefore.meanSpan() << " -> " << totalAfter.meanSpan() << " vertices" << endl;
+	}
+}
+
+#endif
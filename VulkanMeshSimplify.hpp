@@ -0,0 +1,261 @@
+#ifndef __VK_MESH_SIMPLIFY_HPP__
+#define __VK_MESH_SIMPLIFY_HPP__
+
+/*
+LOD chain generation, SceneLoadOptions::lodLevels.
+
+Each level halves the triangle count of the previous one with quadric error (Garland / Heckbert) half edge
+collapses: a vertex is folded onto a neighbour, so every level indexes the mesh's original vertices and only
+costs its index range. Collapses run in passes, cheapest first, touching each neighbourhood once per pass so the
+flip test stays valid. Border and attribute seam vertices are locked, which keeps levels crack free at the cost
+of some reduction on heavily split meshes.
+
+Levels are appended to the global index array after the imported meshes and described by MeshLod entries.
+*/
+
+namespace VkApplication {
+
+	// meshes below this many triangles are already cheap, a level that cannot get below 85% of its parent is dropped
+	constexpr uint32_t LOD_MIN_TRIANGLES = 64;
+	constexpr float LOD_MIN_REDUCTION = 0.85f;
+
+	struct Quadric {
+		double a00 = 0, a01 = 0, a02 = 0, a03 = 0, a11 = 0, a12 = 0, a13 = 0, a22 = 0, a23 = 0, a33 = 0;
+		double weight = 0;
+
+		void addPlane(const glm::vec3& n, double d, double w) {
+			a00 += w * n.x * n.x; a01 += w * n.x * n.y; a02 += w * n.x * n.z; a03 += w * n.x * d;
+			a11 += w * n.y * n.y; a12 += w * n.y * n.z; a13 += w * n.y * d;
+			a22 += w * n.z * n.z; a23 += w * n.z * d;
+			a33 += w * d * d;
+			weight += w;
+		}
+
+		void add(const Quadric& o) {
+			a00 += o.a00; a01 += o.a01; a02 += o.a02; a03 += o.a03;
+			a11 += o.a11; a12 += o.a12; a13 += o.a13;
+			a22 += o.a22; a23 += o.a23;
+			a33 += o.a33;
+			weight += o.weight;
+		}
+
+		// area weighted squared distance of p to the accumulated planes
+		double evaluate(const glm::vec3& p) const {
+			double x = p.x, y = p.y, z = p.z;
+			return a00 * x * x + 2 * a01 * x * y + 2 * a02 * x * z + 2 * a03 * x
+				+ a11 * y * y + 2 * a12 * y * z + 2 * a13 * y
+				+ a22 * z * z + 2 * a23 * z + a33;
+		}
+	};
+
+	// simplifier state for one mesh, successive simplify() calls build the chain level by level
+	class MeshSimplifier {
+	private:
+		const Vertex* vertices;
+		uint32_t vertexCount;
+		std::vector<Quadric> quadrics;
+		std::vector<uint8_t> locked;
+
+		struct Collapse {
+			uint32_t from;
+			uint32_t to;
+			double cost;
+		};
+
+		bool flips(uint32_t from, uint32_t to, const std::vector<uint32_t>& tris,
+			const std::vector<uint32_t>& adjOffsets, const std::vector<uint32_t>& adjTris) const {
+			const glm::vec3 target = vertices[to].pos;
+			for (uint32_t a = adjOffsets[from]; a < adjOffsets[from + 1]; ++a) {
+				const uint32_t* tri = &tris[adjTris[a] * 3];
+				if (tri[0] == to || tri[1] == to || tri[2] == to) continue; // collapses away
+
+				glm::vec3 p[3] = { vertices[tri[0]].pos, vertices[tri[1]].pos, vertices[tri[2]].pos };
+				glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+				for (int k = 0; k < 3; ++k) if (tri[k] == from) p[k] = target;
+				glm::vec3 after = glm::cross(p[1] - p[0], p[2] - p[0]);
+				if (glm::dot(before, after) <= 0.0f) return true;
+			}
+			return false;
+		}
+
+	public:
+		MeshSimplifier(const Vertex* meshVertices, uint32_t meshVertexCount, const std::vector<uint32_t>& tris)
+			: vertices(meshVertices), vertexCount(meshVertexCount), quadrics(meshVertexCount), locked(meshVertexCount, 0) {
+
+			for (size_t t = 0; t + 2 < tris.size(); t += 3) {
+				const glm::vec3& p0 = vertices[tris[t]].pos;
+				glm::vec3 n = glm::cross(vertices[tris[t + 1]].pos - p0, vertices[tris[t + 2]].pos - p0);
+				float doubleArea = glm::length(n);
+				if (doubleArea <= 0.0f) continue;
+				n /= doubleArea;
+				double d = -glm::dot(n, p0);
+				for (int k = 0; k < 3; ++k) quadrics[tris[t + k]].addPlane(n, d, doubleArea * 0.5);
+			}
+
+			// border edges are used by a single triangle
+			std::vector<uint64_t> edges;
+			edges.reserve(tris.size());
+			for (size_t t = 0; t + 2 < tris.size(); t += 3) {
+				for (int k = 0; k < 3; ++k) {
+					uint64_t a = tris[t + k], b = tris[t + (k + 1) % 3];
+					edges.push_back(a < b ? (a << 32) | b : (b << 32) | a);
+				}
+			}
+			std::sort(edges.begin(), edges.end());
+			for (size_t i = 0; i < edges.size();) {
+				size_t j = i;
+				while (j < edges.size() && edges[j] == edges[i]) ++j;
+				if (j - i == 1) {
+					locked[uint32_t(edges[i] >> 32)] = 1;
+					locked[uint32_t(edges[i] & 0xFFFFFFFF)] = 1;
+				}
+				i = j;
+			}
+
+			// split vertices (same position, different normal / uv) would tear apart if folded on their own
+			std::vector<uint32_t> byPosition(vertexCount);
+			std::iota(byPosition.begin(), byPosition.end(), 0u);
+			auto posLess = [&](uint32_t a, uint32_t b) {
+				const glm::vec3& p = vertices[a].pos;
+				const glm::vec3& q = vertices[b].pos;
+				return p.x != q.x ? p.x < q.x : p.y != q.y ? p.y < q.y : p.z < q.z;
+			};
+			std::sort(byPosition.begin(), byPosition.end(), posLess);
+			for (uint32_t i = 1; i < vertexCount; ++i) {
+				if (vertices[byPosition[i]].pos == vertices[byPosition[i - 1]].pos)
+					locked[byPosition[i]] = locked[byPosition[i - 1]] = 1;
+			}
+		}
+
+		// simplifies tris in place towards targetIndexCount, returns the rms distance error of the worst collapse
+		float simplify(std::vector<uint32_t>& tris, size_t targetIndexCount) {
+			double worst = 0.0;
+			std::vector<uint32_t> adjOffsets, adjTris, remap;
+			std::vector<uint8_t> touched;
+			std::vector<Collapse> collapses;
+
+			while (tris.size() > targetIndexCount) {
+				const uint32_t triangleCount = static_cast<uint32_t>(tris.size() / 3);
+
+				adjOffsets.assign(vertexCount + 1, 0);
+				for (uint32_t index : tris) adjOffsets[index + 1]++;
+				for (uint32_t v = 0; v < vertexCount; ++v) adjOffsets[v + 1] += adjOffsets[v];
+				adjTris.resize(tris.size());
+				{
+					std::vector<uint32_t> cursor(adjOffsets.begin(), adjOffsets.end() - 1);
+					for (uint32_t i = 0; i < tris.size(); ++i) adjTris[cursor[tris[i]]++] = i / 3;
+				}
+
+				// every interior edge shows up once as (a < b), try both directions and keep the cheaper one
+				collapses.clear();
+				for (uint32_t i = 0; i < tris.size(); ++i) {
+					uint32_t a = tris[i], b = tris[i - i % 3 + (i + 1) % 3];
+					if (a >= b || (locked[a] && locked[b])) continue;
+					Quadric q = quadrics[a];
+					q.add(quadrics[b]);
+					double toB = locked[a] ? DBL_MAX : q.evaluate(vertices[b].pos);
+					double toA = locked[b] ? DBL_MAX : q.evaluate(vertices[a].pos);
+					if (toB <= toA) collapses.push_back({ a, b, toB });
+					else collapses.push_back({ b, a, toA });
+				}
+				std::sort(collapses.begin(), collapses.end(), [](const Collapse& l, const Collapse& r) { return l.cost < r.cost; });
+
+				remap.resize(vertexCount);
+				std::iota(remap.begin(), remap.end(), 0u);
+				touched.assign(vertexCount, 0);
+
+				const uint32_t needed = triangleCount - static_cast<uint32_t>(targetIndexCount / 3);
+				uint32_t removed = 0, collapsed = 0;
+				for (const Collapse& c : collapses) {
+					if (removed >= needed) break;
+					if (touched[c.from] || touched[c.to]) continue;
+					if (flips(c.from, c.to, tris, adjOffsets, adjTris)) continue;
+
+					for (uint32_t a = adjOffsets[c.from]; a < adjOffsets[c.from + 1]; ++a) {
+						const uint32_t* tri = &tris[adjTris[a] * 3];
+						if (tri[0] == c.to || tri[1] == c.to || tri[2] == c.to) removed++;
+						touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = 1;
+					}
+					remap[c.from] = c.to;
+					quadrics[c.to].add(quadrics[c.from]);
+					worst = std::max(worst, c.cost / std::max(quadrics[c.to].weight, 1e-30));
+					collapsed++;
+				}
+				if (collapsed == 0) break;
+
+				size_t write = 0;
+				for (size_t t = 0; t < tris.size(); t += 3) {
+					uint32_t a = remap[tris[t]], b = remap[tris[t + 1]], c = remap[tris[t + 2]];
+					if (a == b || b == c || a == c) continue;
+					tris[write++] = a; tris[write++] = b; tris[write++] = c;
+				}
+				tris.resize(write);
+			}
+			return static_cast<float>(std::sqrt(std::max(worst, 0.0)));
+		}
+	};
+
+	// levels >= 1 for every mesh, appended to indices in (mesh, level) order
+	void generateMeshLods(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices,
+		const std::vector<MeshRange>& meshRanges, std::vector<MeshLod>& meshLods, uint32_t levels, ThreadPool* pool) {
+
+		auto startTime = std::chrono::high_resolution_clock::now();
+
+		struct LevelData {
+			std::vector<uint32_t> indices;
+			float error;
+		};
+		std::vector<std::vector<LevelData>> chains(meshRanges.size());
+
+		auto simplify = [&](size_t m) {
+			const MeshRange& range = meshRanges[m];
+			if (range.indexCount / 3 < LOD_MIN_TRIANGLES) return;
+
+			std::vector<uint32_t> tris(indices.begin() + range.firstIndex, indices.begin() + range.firstIndex + range.indexCount);
+			for (uint32_t& index : tris) index -= range.firstVertex;
+
+			MeshSimplifier simplifier(vertices.data() + range.firstVertex, range.vertexCount, tris);
+			size_t previous = tris.size();
+			for (uint32_t level = 1; level <= levels; ++level) {
+				size_t target = (previous / 6) * 3; // half the triangles of the parent level
+				float error = simplifier.simplify(tris, target);
+				if (tris.size() > previous * LOD_MIN_REDUCTION || tris.empty()) break;
+				previous = tris.size();
+
+				LevelData data{ tris, error };
+				for (uint32_t& index : data.indices) index += range.firstVertex;
+				chains[m].push_back(std::move(data));
+			}
+		};
+
+		if (pool) pool->parallelFor(meshRanges.size(), simplify);
+		else for (size_t m = 0; m < meshRanges.size(); ++m) simplify(m);
+
+		uint64_t baseTriangles = 0, lodTriangles = 0;
+		meshLods.clear();
+		for (uint32_t m = 0; m < meshRanges.size(); ++m) {
+			baseTriangles += meshRanges[m].indexCount / 3;
+			for (uint32_t l = 0; l < chains[m].size(); ++l) {
+				const LevelData& data = chains[m][l];
+				if (indices.size() + data.indices.size() > UINT32_MAX) throw std::runtime_error("model does not fit 32 bit indices!");
+
+				MeshLod lod;
+				lod.mesh = m;
+				lod.level = l + 1;
+				lod.firstIndex = static_cast<uint32_t>(indices.size());
+				lod.indexCount = static_cast<uint32_t>(data.indices.size());
+				lod.error = data.error;
+				meshLods.push_back(lod);
+
+				indices.insert(indices.end(), data.indices.begin(), data.indices.end());
+				lodTriangles += lod.indexCount / 3;
+			}
+		}
+
+		std::cout << "LODs : " << meshLods.size() << " levels over " << meshRanges.size() << " meshes, "
+			<< lodTriangles << " extra triangles on " << baseTriangles << " in "
+			<< elapsedMs(startTime, std::chrono::high_resolution_clock::now()) << " ms" << std::endl;
+	}
+}
+
+#endif
@@ -30,9 +30,8 @@ namespace VkApplication {
 		// Bind ray tracing pipeline
 		vkCmdBindPipeline(commandBufferRT, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, rayTracingPipeline);
 
-		// Bind descriptor sets
-		vkCmdBindDescriptorSets(commandBufferRT, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, pipelineLayoutRT,
-			0, 1, &descriptorSetRT, 0, nullptr);
+		// Bind descriptor sets, set 0 carries this frame's uniform ring offsets
+		bindFrameUniforms(commandBufferRT, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, pipelineLayoutRT, static_cast<uint32_t>(currentFrame));
 
 		// Define the shader binding table regions
 		VkStridedDeviceAddressRegionKHR raygenShaderBindingTable{};
@@ -81,64 +80,13 @@ namespace VkApplication {
 		submitInfo.pSignalSemaphores = signalSemaphores;
 
 		check_vk_result(vkResetFences(device, 1, &renderFenceRT));
+		acquireStaged();
 
 		if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, renderFenceRT) != VK_SUCCESS) {
 			throw std::runtime_error("Failed to submit draw command buffer");
 		}
 	}
 
-	void MainVulkApplication::recordCommandBuffer() {
-
-		VkCommandBufferBeginInfo beginInfo{};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
-
-		if (vkBeginCommandBuffer(commandBufferRT, &beginInfo) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to begin recording command buffer");
-		}
-
-		// Transition the image layout if necessary (depends on your specific case)
-		// transitionImageLayouts(commandBuffer);
-
-		// Bind ray tracing pipeline
-		vkCmdBindPipeline(commandBufferRT, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, rayTracingPipeline);
-
-		// Bind descriptor sets
-		vkCmdBindDescriptorSets(commandBufferRT, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, pipelineLayoutRT,
-			0, 1, &descriptorSetRT, 0, nullptr);
-
-		// Define the shader binding table regions
-		VkStridedDeviceAddressRegionKHR raygenShaderBindingTable{};
-		raygenShaderBindingTable.deviceAddress = shaderBindingTables.raygen.stridedDeviceAddressRegion.deviceAddress;
-		raygenShaderBindingTable.stride = shaderBindingTables.raygen.stridedDeviceAddressRegion.stride;
-		raygenShaderBindingTable.size = shaderBindingTables.raygen.stridedDeviceAddressRegion.size;
-
-		VkStridedDeviceAddressRegionKHR missShaderBindingTable{};
-		missShaderBindingTable.deviceAddress = shaderBindingTables.miss.stridedDeviceAddressRegion.deviceAddress;
-		missShaderBindingTable.stride = shaderBindingTables.miss.stridedDeviceAddressRegion.stride;
-		missShaderBindingTable.size = shaderBindingTables.miss.stridedDeviceAddressRegion.size;
-
-		VkStridedDeviceAddressRegionKHR hitShaderBindingTable{};
-		hitShaderBindingTable.deviceAddress = shaderBindingTables.hit.stridedDeviceAddressRegion.deviceAddress;
-		hitShaderBindingTable.stride = shaderBindingTables.hit.stridedDeviceAddressRegion.stride;
-		hitShaderBindingTable.size = shaderBindingTables.hit.stridedDeviceAddressRegion.size;
-
-		VkStridedDeviceAddressRegionKHR callableShaderBindingTable{};
-
-		// Issue the ray tracing command
-		vkCmdTraceRaysKHR(commandBufferRT, &raygenShaderBindingTable, &missShaderBindingTable,
-			&hitShaderBindingTable, &callableShaderBindingTable, swapChainExtent.width, swapChainExtent.height, 1);
-
-		// Transition the image layout if necessary (depends on your specific case)
-		// transitionImageLayoutsForSampling(commandBuffer);
-
-		if (vkEndCommandBuffer(commandBufferRT) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to record command buffer");
-		}
-	}
-
-
-
 	void MainVulkApplication::setupCommandBuffer() {
 
 	}
@@ -147,40 +95,46 @@ namespace VkApplication {
 
 	
 
-	void MainVulkApplication::createScratchBuffer(VkDeviceSize size) {
-
-		createBuffer(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-			VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT_KHR,
-			scratchBuffer.handle, scratchBuffer.memory, true);
-		/*
-		// Buffer and memory
-		VkBufferCreateInfo bufferCreateInfo{};
-		bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-		bufferCreateInfo.size = size;
-		bufferCreateInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
-		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE; // Assuming exclusive sharing mode
-		check_vk_result(vkCreateBuffer(device, &bufferCreateInfo, nullptr, &scratchBuffer.handle));
-
-		VkMemoryRequirements memoryRequirements{};
-		vkGetBufferMemoryRequirements(device, scratchBuffer.handle, &memoryRequirements);
-
-		VkMemoryAllocateFlagsInfo memoryAllocateFlagsInfo{};
-		memoryAllocateFlagsInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO;
-		memoryAllocateFlagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT_KHR;
-
-		VkMemoryAllocateInfo memoryAllocateInfo{};
-		memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		memoryAllocateInfo.pNext = &memoryAllocateFlagsInfo;
-		memoryAllocateInfo.allocationSize = memoryRequirements.size;
-		memoryAllocateInfo.memoryTypeIndex = findMemoryType(memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		check_vk_result(vkAllocateMemory(device, &memoryAllocateInfo, nullptr, &scratchBuffer.memory));
-		check_vk_result(vkBindBufferMemory(device, scratchBuffer.handle, scratchBuffer.memory, 0));
-		*/
-		// Buffer device address
+	VkDeviceAddress MainVulkApplication::GetBufferDeviceAddress(VkBuffer buffer) {
 		VkBufferDeviceAddressInfoKHR bufferDeviceAddressInfo{};
 		bufferDeviceAddressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
-		bufferDeviceAddressInfo.buffer = scratchBuffer.handle;
-		scratchBuffer.deviceAddress = vkGetBufferDeviceAddressKHR(device, &bufferDeviceAddressInfo);
+		bufferDeviceAddressInfo.buffer = buffer;
+		return vkGetBufferDeviceAddressKHR(device, &bufferDeviceAddressInfo);
+	}
+
+	/*
+	Build scratch is one persistent buffer, sized to the largest batch seen so far. A batch sums scratchFootprint of its
+	builds, resetScratch makes room for that, and every build takes its range with allocateScratch. The ranges start
+	at device addresses aligned to minAccelerationStructureScratchOffsetAlignment, so several builds can share one
+	vkCmdBuildAccelerationStructuresKHR. Builds wait for their submission, so the next reset never overlaps a running one.
+	*/
+	VkDeviceSize MainVulkApplication::scratchFootprint(VkDeviceSize size) {
+		const VkDeviceSize alignment = std::max<VkDeviceSize>(1, accelerationStructureProperties.minAccelerationStructureScratchOffsetAlignment);
+		return align_up(size, alignment);
+	}
+
+	void MainVulkApplication::resetScratch(VkDeviceSize footprint) {
+		scratchBuffer.head = 0;
+		// one alignment of slack, the buffer's own address is only aligned to its memory requirements
+		const VkDeviceSize capacity = footprint + scratchFootprint(1);
+		if (capacity <= scratchBuffer.capacity) return;
+
+		destroyBuffer(scratchBuffer.handle, scratchBuffer.memory);
+		createBuffer(capacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			scratchBuffer.handle, scratchBuffer.memory, true, MemoryCategory::Scratch);
+		scratchBuffer.deviceAddress = GetBufferDeviceAddress(scratchBuffer.handle);
+		scratchBuffer.capacity = capacity;
+		scratchBuffer.grows++;
+	}
+
+	VkDeviceAddress MainVulkApplication::allocateScratch(VkDeviceSize size) {
+		const VkDeviceAddress address = align_up<VkDeviceAddress>(scratchBuffer.deviceAddress + scratchBuffer.head, scratchFootprint(1));
+		const VkDeviceSize end = address - scratchBuffer.deviceAddress + size;
+		if (end > scratchBuffer.capacity) throw std::runtime_error("scratch range outside the reserved batch!");
+		scratchBuffer.head = end;
+		scratchBuffer.ranges++;
+		return address;
 	}
 
 }
@@ -54,7 +54,7 @@ namespace VkApplication {
 		createBuffer(uint64_t(rayTracingPipelineProperties.shaderGroupHandleSize * handleCount),
 			VK_BUFFER_USAGE_SHADER_BINDING_TABLE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			extendedBuffer.buffer, extendedBuffer.memory, true);
+			extendedBuffer.buffer, extendedBuffer.memory, true, MemoryCategory::SBT);
 		// Get the strided address to be used when dispatching the rays
 
 		const uint32_t handleSizeAligned = align_up(rayTracingPipelineProperties.shaderGroupHandleSize, rayTracingPipelineProperties.shaderGroupHandleAlignment);
@@ -76,15 +76,18 @@ namespace VkApplication {
 
 	void MainVulkApplication::createAccelerationStructure(AccelerationStructure& accelerationStructure,
 		VkAccelerationStructureTypeKHR type,
-		VkAccelerationStructureBuildSizesInfoKHR buildSizeInfo) {
+		VkAccelerationStructureBuildSizesInfoKHR buildSizeInfo,
+		bool hostVisible) {
 
 		using std::cout; using std::endl;
 
 		cout << "Acceleration Structure Buffer : " << static_cast<uint64_t>(buildSizeInfo.accelerationStructureSize) << endl;
+		// vkBuildAccelerationStructuresKHR writes through a host mapping, the TLAS still references it by device address
 		createBuffer(buildSizeInfo.accelerationStructureSize,
 			VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-			VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT_KHR,
-			accelerationStructure.buffer, accelerationStructure.memory, true);
+			hostVisible ? VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			accelerationStructure.buffer, accelerationStructure.memory, true,
+			type == VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR ? MemoryCategory::TLAS : MemoryCategory::BLAS);
 		/*
 		// Buffer and memory
 		VkBufferCreateInfo bufferCreateInfo{};
@@ -109,6 +112,10 @@ namespace VkApplication {
 		check_vk_result(vkAllocateMemory(device, &memoryAllocateInfo, nullptr, &accelerationStructure.memory));
 		check_vk_result(vkBindBufferMemory(device, accelerationStructure.buffer, accelerationStructure.memory, 0));
 		*/
+		accelerationStructure.size = buildSizeInfo.accelerationStructureSize;
+		accelerationStructure.type = type;
+		accelerationStructure.hostVisible = hostVisible;
+
 		// Acceleration structure
 		VkAccelerationStructureCreateInfoKHR accelerationStructureCreateInfo{};
 		accelerationStructureCreateInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR;
@@ -124,6 +131,13 @@ namespace VkApplication {
 		accelerationStructure.deviceAddress = vkGetAccelerationStructureDeviceAddressKHR(device, &accelerationDeviceAddressInfo);
 	}
 
+	void MainVulkApplication::destroyAccelerationStructure(AccelerationStructure& accelerationStructure) {
+		if (accelerationStructure.handle == VK_NULL_HANDLE) return;
+		vkDestroyAccelerationStructureKHR(device, accelerationStructure.handle, nullptr);
+		destroyBuffer(accelerationStructure.buffer, accelerationStructure.memory);
+		accelerationStructure = AccelerationStructure{};
+	}
+
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,218 @@
+#ifndef __VK_SCENE_CACHE_HPP__
+#define __VK_SCENE_CACHE_HPP__
+
+namespace VkApplication {
+
+	/*
+	Cooked copy of an imported model, written next to the source as <source>.rtcache
+
+		/----------------------\
+		| SceneCacheHeader     |
+		|----------------------|
+		| MeshRange  [meshes]  |
+		| Material   [mats]    |
+		| MeshLod    [lods]    |
+		| MeshInstance [insts] |
+		| Vertex     [verts]   |
+		| uint32_t   [indices] |
+		\----------------------/
+
+	Sections are 16 byte aligned and stored exactly as they are in memory, so a warm start maps the file
+	and the vertex / index sections are memcpy'd straight into the staging buffers.
+	The cache is only valid for the same source bytes, import flags, processing flags and struct layouts.
+	*/
+
+	constexpr uint32_t SCENE_CACHE_MAGIC = 0x48435452; // "RTCH"
+	constexpr uint32_t SCENE_CACHE_VERSION = 4;  // 4: MeshInstance.motion
+	constexpr uint64_t SCENE_CACHE_ALIGNMENT = 16;
+
+	// processFlags bits, anything that changes the cooked output for the same source bytes
+	enum SceneProcessFlags : uint32_t {
+		SCENE_PROCESS_NATIVE_GLB = 1u << 0,
+		SCENE_PROCESS_REORDERED = 1u << 1,
+		SCENE_PROCESS_LODS = 1u << 2
+	};
+	// bits from here up hold SceneLoadOptions::lodLevels
+	constexpr uint32_t SCENE_PROCESS_LOD_LEVEL_SHIFT = 8;
+
+	struct SceneCacheHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint64_t sourceHash;
+		uint64_t sourceSize;
+		uint32_t importFlags;
+		uint32_t processFlags;
+		uint32_t vertexStride;
+		uint32_t materialStride;
+		uint32_t meshRangeStride;
+		uint32_t meshLodStride;
+		uint32_t meshInstanceStride;
+		uint32_t meshCount;
+		uint32_t materialCount;
+		uint32_t lodCount;
+		uint32_t instanceCount;
+		uint64_t vertexCount;
+		uint64_t indexCount;
+		uint64_t meshOffset;
+		uint64_t materialOffset;
+		uint64_t lodOffset;
+		uint64_t instanceOffset;
+		uint64_t vertexOffset;
+		uint64_t indexOffset;
+	};
+
+	std::string sceneCachePath(const std::string& sourcePath) {
+		return sourcePath + ".rtcache";
+	}
+
+	// hash of the source asset bytes, false if the file cannot be read
+	bool hashSourceFile(const std::string& path, uint64_t& hash, uint64_t& size) {
+		MappedFile source;
+		if (!source.open(path)) return false;
+		hash = hashBytes(source.data(), source.size());
+		size = source.size();
+		return true;
+	}
+
+	bool MainVulkApplication::loadSceneCache(uint64_t sourceHash, uint64_t sourceSize, uint32_t processFlags) {
+
+		auto cache = std::make_unique<MappedFile>();
+		if (!cache->open(sceneCachePath(MODEL_PATH)) || cache->size() < sizeof(SceneCacheHeader)) return false;
+
+		SceneCacheHeader header;
+		memcpy(&header, cache->data(), sizeof(header));
+
+		if (header.magic != SCENE_CACHE_MAGIC || header.version != SCENE_CACHE_VERSION ||
+			header.sourceHash != sourceHash || header.sourceSize != sourceSize ||
+			header.importFlags != MODEL_IMPORT_FLAGS || header.processFlags != processFlags ||
+			header.vertexStride != sizeof(Vertex) || header.materialStride != sizeof(Material) ||
+			header.meshRangeStride != sizeof(MeshRange) || header.meshLodStride != sizeof(MeshLod) ||
+			header.meshInstanceStride != sizeof(MeshInstance))
+			return false;
+
+		// a truncated write must not be trusted
+		auto sectionFits = [&](uint64_t offset, uint64_t count, uint64_t stride) {
+			return offset % SCENE_CACHE_ALIGNMENT == 0 && count <= (cache->size() - std::min<uint64_t>(offset, cache->size())) / stride;
+		};
+		if (!sectionFits(header.meshOffset, header.meshCount, sizeof(MeshRange)) ||
+			!sectionFits(header.materialOffset, header.materialCount, sizeof(Material)) ||
+			!sectionFits(header.lodOffset, header.lodCount, sizeof(MeshLod)) ||
+			!sectionFits(header.instanceOffset, header.instanceCount, sizeof(MeshInstance)) ||
+			!sectionFits(header.vertexOffset, header.vertexCount, sizeof(Vertex)) ||
+			!sectionFits(header.indexOffset, header.indexCount, sizeof(uint32_t)))
+			return false;
+
+		const uint8_t* base = cache->data();
+
+		meshRanges.resize(header.meshCount);
+		if (header.meshCount) memcpy(meshRanges.data(), base + header.meshOffset, header.meshCount * sizeof(MeshRange));
+		materials.resize(header.materialCount);
+		if (header.materialCount) memcpy(materials.data(), base + header.materialOffset, header.materialCount * sizeof(Material));
+		meshLods.resize(header.lodCount);
+		if (header.lodCount) memcpy(meshLods.data(), base + header.lodOffset, header.lodCount * sizeof(MeshLod));
+		meshInstances.resize(header.instanceCount);
+		if (header.instanceCount) memcpy(meshInstances.data(), base + header.instanceOffset, header.instanceCount * sizeof(MeshInstance));
+
+		// vertex and index data stay in the mapping until they are copied to the gpu
+		vertices.clear();
+		indices.clear();
+		geometry.vertices = reinterpret_cast<const Vertex*>(base + header.vertexOffset);
+		geometry.vertexCount = static_cast<size_t>(header.vertexCount);
+		geometry.indices = reinterpret_cast<const uint32_t*>(base + header.indexOffset);
+		geometry.indexCount = static_cast<size_t>(header.indexCount);
+
+		sceneCacheFile = std::move(cache);
+		return true;
+	}
+
+	void MainVulkApplication::writeSceneCache(uint64_t sourceHash, uint64_t sourceSize, uint32_t processFlags) {
+
+		SceneCacheHeader header{};
+		header.magic = SCENE_CACHE_MAGIC;
+		header.version = SCENE_CACHE_VERSION;
+		header.sourceHash = sourceHash;
+		header.sourceSize = sourceSize;
+		header.importFlags = MODEL_IMPORT_FLAGS;
+		header.processFlags = processFlags;
+		header.vertexStride = sizeof(Vertex);
+		header.materialStride = sizeof(Material);
+		header.meshRangeStride = sizeof(MeshRange);
+		header.meshLodStride = sizeof(MeshLod);
+		header.meshInstanceStride = sizeof(MeshInstance);
+		header.meshCount = static_cast<uint32_t>(meshRanges.size());
+		header.materialCount = static_cast<uint32_t>(materials.size());
+		header.lodCount = static_cast<uint32_t>(meshLods.size());
+		header.instanceCount = static_cast<uint32_t>(meshInstances.size());
+		header.vertexCount = geometry.vertexCount;
+		header.indexCount = geometry.indexCount;
+
+		uint64_t offset = align_up<uint64_t>(sizeof(SceneCacheHeader), SCENE_CACHE_ALIGNMENT);
+		header.meshOffset = offset;
+		offset = align_up<uint64_t>(offset + meshRanges.size() * sizeof(MeshRange), SCENE_CACHE_ALIGNMENT);
+		header.materialOffset = offset;
+		offset = align_up<uint64_t>(offset + materials.size() * sizeof(Material), SCENE_CACHE_ALIGNMENT);
+		header.lodOffset = offset;
+		offset = align_up<uint64_t>(offset + meshLods.size() * sizeof(MeshLod), SCENE_CACHE_ALIGNMENT);
+		header.instanceOffset = offset;
+		offset = align_up<uint64_t>(offset + meshInstances.size() * sizeof(MeshInstance), SCENE_CACHE_ALIGNMENT);
+		header.vertexOffset = offset;
+		offset = align_up<uint64_t>(offset + geometry.vertexCount * sizeof(Vertex), SCENE_CACHE_ALIGNMENT);
+		header.indexOffset = offset;
+
+		// write beside the real file and swap it in so a crash never leaves a half written cache behind
+		const std::string path = sceneCachePath(MODEL_PATH);
+		const std::string tempPath = path + ".tmp";
+		{
+			std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+			if (!file) {
+				std::cerr << "scene cache : cannot write " << tempPath << std::endl;
+				return;
+			}
+
+			auto writeSection = [&](uint64_t sectionOffset, const void* data, size_t bytes) {
+				static const char zeros[SCENE_CACHE_ALIGNMENT] = {};
+				uint64_t position = static_cast<uint64_t>(file.tellp());
+				file.write(zeros, static_cast<std::streamsize>(sectionOffset - position));
+				if (bytes) file.write(static_cast<const char*>(data), static_cast<std::streamsize>(bytes));
+			};
+
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			writeSection(header.meshOffset, meshRanges.data(), meshRanges.size() * sizeof(MeshRange));
+			writeSection(header.materialOffset, materials.data(), materials.size() * sizeof(Material));
+			writeSection(header.lodOffset, meshLods.data(), meshLods.size() * sizeof(MeshLod));
+			writeSection(header.instanceOffset, meshInstances.data(), meshInstances.size() * sizeof(MeshInstance));
+			writeSection(header.vertexOffset, geometry.vertices, geometry.vertexCount * sizeof(Vertex));
+			writeSection(header.indexOffset, geometry.indices, geometry.indexCount * sizeof(uint32_t));
+
+			if (!file) {
+				std::cerr << "scene cache : write failed for " << tempPath << std::endl;
+				file.close();
+				std::remove(tempPath.c_str());
+				return;
+			}
+		}
+
+		// replace in one step so a failed write never leaves the source without a cache,
+		// rename does that on POSIX, on Windows it refuses an existing target
+#ifdef _WIN32
+		const bool replaced = MoveFileExA(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+		const bool replaced = std::rename(tempPath.c_str(), path.c_str()) == 0;
+#endif
+		if (!replaced) {
+			std::cerr << "scene cache : cannot replace " << path << std::endl;
+			std::remove(tempPath.c_str());
+		}
+	}
+
+	// the mapped cache is only needed until the geometry is on the gpu
+	void MainVulkApplication::releaseSceneCache() {
+		if (!sceneCacheFile) return;
+		// counts stay valid for draw / build code, the pointers would dangle
+		geometry.vertices = nullptr;
+		geometry.indices = nullptr;
+		sceneCacheFile.reset();
+	}
+}
+
+#endif
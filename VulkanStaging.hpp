@@ -0,0 +1,345 @@
+#ifndef __VK_STAGING_HPP__
+#define __VK_STAGING_HPP__
+
+/*
+Persistent staging arena, every host to device upload goes through it.
+
+	one host visible buffer, mapped for the lifetime of the device, handed out by a StagingRing
+	copies are recorded into an open command buffer, flushStaging submits it to transferQueue
+	every batch signals the next value of transferTimeline, its ring regions come back once the value is reached
+	waits only happen when the ring is full
+
+transferQueue is a transfer only family when the device has one, the copies then run on the DMA engine next to
+rendering. Destinations are exclusive to one family, so a finished destination is released by the batch that
+completes it (releaseStagedBuffer / releaseStagedImage) and acquired on the graphics queue by acquireStaged, which
+every graphics submit calls first. That submission waits on the timeline on the GPU, the host never waits for an
+upload and the graphics queue only waits when uploads are outstanding.
+
+Without a transfer family the batches go to the graphics queue, each ends with a barrier that makes the transfer
+writes visible to everything submitted after it and acquireStaged has nothing to do.
+Destinations have to be new or owned by the transfer queue, nothing hands a buffer back from graphics to transfer.
+
+Uploads end with finishUpload, which submits the batch right away. Between beginUploadBatch and endUploadBatch it
+leaves the batch open instead, so a whole scene's buffers and textures, their copies, layout transitions and
+releases, go out in as few submissions as the arena allows (a full ring still flushes).
+*/
+
+namespace VkApplication {
+
+	constexpr VkDeviceSize STAGING_ARENA_SIZE = 64ull * 1024 * 1024;
+	// covers texel block and optimalBufferCopyOffsetAlignment on every device we target
+	constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+
+	void MainVulkApplication::createStagingArena() {
+		createBuffer(STAGING_ARENA_SIZE, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			stagingBuffer, stagingMemory, false, MemoryCategory::Staging);
+		stagingRing = StagingRing(STAGING_ARENA_SIZE);
+
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = transferFamilyIndex;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+		check_vk_result(vkCreateCommandPool(device, &poolInfo, nullptr, &transferCommandPool));
+
+		VkSemaphoreTypeCreateInfo timelineInfo{};
+		timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+		timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+		timelineInfo.initialValue = 0;
+		VkSemaphoreCreateInfo semaphoreInfo{};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		semaphoreInfo.pNext = &timelineInfo;
+		check_vk_result(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &transferTimeline));
+	}
+
+	void MainVulkApplication::destroyStagingArena() {
+		waitStaging();
+		for (StagingAcquire& acquire : stagingAcquires) {
+			check_vk_result(vkWaitForFences(device, 1, &acquire.fence, VK_TRUE, UINT64_MAX));
+			vkFreeCommandBuffers(device, commandPool, 1, &acquire.commandBuffer);
+			vkDestroyFence(device, acquire.fence, nullptr);
+		}
+		stagingAcquires.clear();
+		for (VkFence fence : stagingFences) vkDestroyFence(device, fence, nullptr);
+		stagingFences.clear();
+		if (singleTimeFence != VK_NULL_HANDLE) vkDestroyFence(device, singleTimeFence, nullptr);
+		singleTimeFence = VK_NULL_HANDLE;
+		vkDestroySemaphore(device, transferTimeline, nullptr);
+		vkDestroyCommandPool(device, transferCommandPool, nullptr);
+		destroyBuffer(stagingBuffer, stagingMemory);
+	}
+
+	// recycles every batch the timeline has passed, or the oldest one when wait is set
+	void MainVulkApplication::retireStaging(bool wait) {
+		uint64_t completed = 0;
+		check_vk_result(vkGetSemaphoreCounterValue(device, transferTimeline, &completed));
+		while (!stagingInFlight.empty()) {
+			StagingBatch& batch = stagingInFlight.front();
+			if (batch.value > completed) {
+				if (!wait) break;
+				VkSemaphoreWaitInfo waitInfo{};
+				waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+				waitInfo.semaphoreCount = 1;
+				waitInfo.pSemaphores = &transferTimeline;
+				waitInfo.pValues = &batch.value;
+				check_vk_result(vkWaitSemaphores(device, &waitInfo, UINT64_MAX));
+				completed = batch.value;
+				stagingStats.waits++;
+				wait = false;
+			}
+
+			stagingRing.release(batch.mark);
+			vkFreeCommandBuffers(device, transferCommandPool, 1, &batch.commandBuffer);
+			stagingInFlight.pop_front();
+		}
+
+		while (!stagingAcquires.empty() && vkGetFenceStatus(device, stagingAcquires.front().fence) == VK_SUCCESS) {
+			StagingAcquire& acquire = stagingAcquires.front();
+			check_vk_result(vkResetFences(device, 1, &acquire.fence));
+			stagingFences.push_back(acquire.fence);
+			vkFreeCommandBuffers(device, commandPool, 1, &acquire.commandBuffer);
+			stagingAcquires.pop_front();
+		}
+	}
+
+	// the open batch, begun on first use
+	VkCommandBuffer MainVulkApplication::openStaging() {
+		if (stagingCommandBuffer != VK_NULL_HANDLE) return stagingCommandBuffer;
+
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandPool = transferCommandPool;
+		allocInfo.commandBufferCount = 1;
+		check_vk_result(vkAllocateCommandBuffers(device, &allocInfo, &stagingCommandBuffer));
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		check_vk_result(vkBeginCommandBuffer(stagingCommandBuffer, &beginInfo));
+		return stagingCommandBuffer;
+	}
+
+	// region of the arena for size bytes, the open batch it must be copied in is stagingCommandBuffer
+	VkDeviceSize MainVulkApplication::acquireStaging(VkDeviceSize size) {
+		retireStaging(false);
+		VkDeviceSize offset;
+		while ((offset = stagingRing.allocate(size, STAGING_ALIGNMENT)) == StagingRing::NONE) {
+			// the open batch holds regions too, it has to be in flight before it can be waited on
+			if (stagingCommandBuffer != VK_NULL_HANDLE) flushStaging();
+			if (stagingInFlight.empty()) throw std::runtime_error("staging request larger than the arena!");
+			retireStaging(true);
+		}
+		openStaging();
+
+		stagingStats.chunks++;
+		stagingStats.bytes += size;
+		stagingStats.peakBytes = std::max(stagingStats.peakBytes, stagingRing.usedBytes());
+		return offset;
+	}
+
+	// copies src into dst at dstOffset, chunked to whatever the arena has room for
+	// the caller releases dst once everything it wants in it is staged
+	void MainVulkApplication::stageToBuffer(VkBuffer dst, VkDeviceSize dstOffset, const void* src, VkDeviceSize size) {
+		const uint8_t* bytes = static_cast<const uint8_t*>(src);
+		const VkDeviceSize chunkSize = STAGING_ARENA_SIZE / 4;
+		for (VkDeviceSize done = 0; done < size; ) {
+			const VkDeviceSize chunk = std::min(chunkSize, size - done);
+			const VkDeviceSize offset = acquireStaging(chunk);
+			memcpy(static_cast<uint8_t*>(stagingMemory.mapped) + offset, bytes + done, chunk);
+
+			VkBufferCopy copyRegion{};
+			copyRegion.srcOffset = offset;
+			copyRegion.dstOffset = dstOffset + done;
+			copyRegion.size = chunk;
+			vkCmdCopyBuffer(stagingCommandBuffer, stagingBuffer, dst, 1, &copyRegion);
+			done += chunk;
+		}
+	}
+
+	// buffer is complete, the open batch hands it to the graphics queue
+	void MainVulkApplication::releaseStagedBuffer(VkBuffer buffer) {
+		if (transferFamilyIndex == graphicsFamilyIndex) return;
+		VkBufferMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.srcQueueFamilyIndex = transferFamilyIndex;
+		barrier.dstQueueFamilyIndex = graphicsFamilyIndex;
+		barrier.buffer = buffer;
+		barrier.offset = 0;
+		barrier.size = VK_WHOLE_SIZE;
+		stagingBufferReleases.push_back(barrier);
+	}
+
+	// image written in TRANSFER_DST_OPTIMAL is complete, it moves to layout with the release / acquire pair
+	void MainVulkApplication::releaseStagedImage(VkImage image, VkImageLayout layout) {
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = layout;
+		barrier.image = image;
+		barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS };
+
+		if (transferFamilyIndex == graphicsFamilyIndex) {
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			vkCmdPipelineBarrier(openStaging(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+				0, 0, nullptr, 0, nullptr, 1, &barrier);
+			return;
+		}
+		barrier.srcQueueFamilyIndex = transferFamilyIndex;
+		barrier.dstQueueFamilyIndex = graphicsFamilyIndex;
+		stagingImageReleases.push_back(barrier);
+	}
+
+	void MainVulkApplication::flushStaging() {
+		if (stagingCommandBuffer == VK_NULL_HANDLE) return;
+
+		if (transferFamilyIndex == graphicsFamilyIndex) {
+			// transfer writes visible to whatever the queue runs next, AS builds, shaders or index fetch
+			VkMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+			vkCmdPipelineBarrier(stagingCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+				0, 1, &barrier, 0, nullptr, 0, nullptr);
+		}
+		else if (!stagingBufferReleases.empty() || !stagingImageReleases.empty()) {
+			// release half, the destination stage and access belong to the acquire
+			vkCmdPipelineBarrier(stagingCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+				static_cast<uint32_t>(stagingBufferReleases.size()), stagingBufferReleases.data(),
+				static_cast<uint32_t>(stagingImageReleases.size()), stagingImageReleases.data());
+			pendingBufferAcquires.insert(pendingBufferAcquires.end(), stagingBufferReleases.begin(), stagingBufferReleases.end());
+			pendingImageAcquires.insert(pendingImageAcquires.end(), stagingImageReleases.begin(), stagingImageReleases.end());
+			stagingBufferReleases.clear();
+			stagingImageReleases.clear();
+		}
+		check_vk_result(vkEndCommandBuffer(stagingCommandBuffer));
+
+		StagingBatch batch;
+		batch.commandBuffer = stagingCommandBuffer;
+		batch.value = ++transferSignalled;
+		batch.mark = stagingRing.head();
+
+		VkTimelineSemaphoreSubmitInfo timelineInfo{};
+		timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timelineInfo.signalSemaphoreValueCount = 1;
+		timelineInfo.pSignalSemaphoreValues = &batch.value;
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.pNext = &timelineInfo;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &batch.commandBuffer;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &transferTimeline;
+		check_vk_result(vkQueueSubmit(transferQueue, 1, &submitInfo, VK_NULL_HANDLE));
+
+		stagingInFlight.push_back(batch);
+		stagingCommandBuffer = VK_NULL_HANDLE;
+		stagingStats.submits++;
+	}
+
+	/*
+	Called before every graphics submit that may read uploads. Flushes the open batch, and with a transfer family
+	submits the acquire half of every release since the last call, waiting on the timeline value of the newest batch.
+	Its barrier covers all commands, so everything submitted to the graphics queue afterwards is ordered after the uploads.
+	*/
+	void MainVulkApplication::acquireStaged() {
+		flushStaging();
+		if (transferFamilyIndex == graphicsFamilyIndex || transferAcquired == transferSignalled) return;
+		retireStaging(false);
+
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandPool = commandPool;
+		allocInfo.commandBufferCount = 1;
+		StagingAcquire acquire;
+		check_vk_result(vkAllocateCommandBuffers(device, &allocInfo, &acquire.commandBuffer));
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		check_vk_result(vkBeginCommandBuffer(acquire.commandBuffer, &beginInfo));
+
+		for (VkBufferMemoryBarrier& barrier : pendingBufferAcquires) {
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+		}
+		for (VkImageMemoryBarrier& barrier : pendingImageAcquires) {
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		}
+		// the memory barrier chains the timeline wait to later submissions even when nothing changes owner
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+		vkCmdPipelineBarrier(acquire.commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier,
+			static_cast<uint32_t>(pendingBufferAcquires.size()), pendingBufferAcquires.data(),
+			static_cast<uint32_t>(pendingImageAcquires.size()), pendingImageAcquires.data());
+		check_vk_result(vkEndCommandBuffer(acquire.commandBuffer));
+		pendingBufferAcquires.clear();
+		pendingImageAcquires.clear();
+
+		if (!stagingFences.empty()) {
+			acquire.fence = stagingFences.back();
+			stagingFences.pop_back();
+		}
+		else {
+			VkFenceCreateInfo fenceInfo{};
+			fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+			check_vk_result(vkCreateFence(device, &fenceInfo, nullptr, &acquire.fence));
+		}
+
+		VkTimelineSemaphoreSubmitInfo timelineInfo{};
+		timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timelineInfo.waitSemaphoreValueCount = 1;
+		timelineInfo.pWaitSemaphoreValues = &transferSignalled;
+
+		const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.pNext = &timelineInfo;
+		submitInfo.waitSemaphoreCount = 1;
+		submitInfo.pWaitSemaphores = &transferTimeline;
+		submitInfo.pWaitDstStageMask = &waitStage;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &acquire.commandBuffer;
+		check_vk_result(vkQueueSubmit(graphicsQueue, 1, &submitInfo, acquire.fence));
+
+		stagingAcquires.push_back(acquire);
+		transferAcquired = transferSignalled;
+		stagingStats.acquires++;
+	}
+
+	void MainVulkApplication::beginUploadBatch() {
+		uploadBatchDepth++;
+	}
+
+	// submits what the batch recorded, with wait set the host blocks until it has landed
+	void MainVulkApplication::endUploadBatch(bool wait) {
+		if (uploadBatchDepth > 0) uploadBatchDepth--;
+		if (uploadBatchDepth > 0) return;
+		if (wait) waitStaging();
+		else flushStaging();
+	}
+
+	// one upload is fully recorded and released
+	void MainVulkApplication::finishUpload() {
+		stagingStats.uploads++;
+		// in flight before anything that reads it is submitted, nothing waits here
+		if (uploadBatchDepth == 0 || !loadOptions.batchUploads) flushStaging();
+	}
+
+	// everything staged so far has landed and the whole arena is free again
+	void MainVulkApplication::waitStaging() {
+		flushStaging();
+		while (!stagingInFlight.empty()) retireStaging(true);
+	}
+}
+
+#endif
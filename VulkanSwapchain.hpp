@@ -32,7 +32,7 @@ namespace VkApplication {
 
 	void MainVulkApplication::createImage(uint32_t width, uint32_t height, 
 		VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, 
-		VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory) {
+		VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory, MemoryCategory category) {
 		VkImageCreateInfo imageInfo{};
 		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
 		imageInfo.imageType = VK_IMAGE_TYPE_2D;
@@ -64,9 +64,19 @@ namespace VkApplication {
 			throw std::runtime_error("failed to allocate image memory!");
 		}
 
+		memoryManager.trackDedicated(imageMemory, allocInfo.allocationSize, allocInfo.memoryTypeIndex, category);
+
 		vkBindImageMemory(device, image, imageMemory, 0);
 	}
 
+	// counterpart of createImage for the memory, drops it from the per category accounting
+	void MainVulkApplication::freeImageMemory(VkDeviceMemory& imageMemory) {
+		if (imageMemory == VK_NULL_HANDLE) return;
+		memoryManager.untrackDedicated(imageMemory);
+		vkFreeMemory(device, imageMemory, nullptr);
+		imageMemory = VK_NULL_HANDLE;
+	}
+
 
 	void MainVulkApplication::recreateSwapChain() {
 		int width = 0, height = 0;
@@ -84,7 +94,7 @@ namespace VkApplication {
 		createImageViews();
 		createGraphicsPipeline();
 		
-		createUniformBuffers();
+		// the frame uniform ring is sized by frames in flight, not swapchain images, so it survives a resize
 		createDescriptorPool();
 		createDescriptorSets();
 		createCommandBuffers();
@@ -217,7 +227,7 @@ namespace VkApplication {
 	void MainVulkApplication::cleanupSwapChain() {
 		vkDestroyImageView(device, depthImageView, nullptr);
 		vkDestroyImage(device, depthImage, nullptr);
-		vkFreeMemory(device, depthImageMemory, nullptr);
+		freeImageMemory(depthImageMemory);
 
 		for (auto framebuffer : swapChainFramebuffers) {
 			vkDestroyFramebuffer(device, framebuffer, nullptr);
@@ -235,11 +245,6 @@ namespace VkApplication {
 
 		vkDestroySwapchainKHR(device, swapChain, nullptr);
 
-		for (size_t i = 0; i < swapChainImages.size(); i++) {
-			vkDestroyBuffer(device, uniformBuffers[i], nullptr);
-			vkFreeMemory(device, uniformBuffersMemory[i], nullptr);
-		}
-
 		vkDestroyDescriptorPool(device, descriptorPool, nullptr);
 	}
 
@@ -19,9 +19,15 @@
 #include <stack>
 #include <thread>
 #include <queue>
+#include <deque>
 #include <mutex>
 #include <condition_variable>
 #include <memory>
+#include <future>
+#include <atomic>
+#include <limits>
+#include <numeric>
+#include <cfloat>
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -62,9 +68,18 @@ constexpr bool enableValidationLayers = true;
 constexpr bool enableValidationLayers = false;
 #endif
 
+#ifdef RT_BENCHMARKS
+constexpr bool enableBenchmarks = true;
+#else
+constexpr bool enableBenchmarks = false;
+#endif
+
 #include "ValidationLayers.hpp"
 // custom memory management module
 #include "MMM.h"
+#include "ThreadPool.h"
+#include "MappedFile.h"
+#include "FrameArena.h"
 
 static void check_vk_result(VkResult err) {
 	if (err == 0)
@@ -74,9 +89,16 @@ static void check_vk_result(VkResult err) {
 		abort();
 }
 
+static double elapsedMs(std::chrono::high_resolution_clock::time_point start, std::chrono::high_resolution_clock::time_point end) {
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
 namespace VkApplication{
 
 	const std::string MODEL_PATH = "models/LPRoom.glb";
+	// post processing used for every import of MODEL_PATH
+	constexpr unsigned int MODEL_IMPORT_FLAGS =
+		aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_JoinIdenticalVertices | aiProcess_GenNormals;
 
 	constexpr int MAX_FRAMES_IN_FLIGHT = 2;
 
@@ -93,9 +115,16 @@ namespace VkApplication{
 	//VK_KHR_SWAPCHAIN_EXTENSION_NAME, VK_KHR_EXTERNAL_SEMAPHORE_EXTENSION_NAME
 	};
 
+	// enabled when the device has them, nothing depends on them being there
+	const std::vector<const char*> optionalDeviceExtensions = {
+		VK_EXT_MEMORY_BUDGET_EXTENSION_NAME,
+		VK_KHR_RAY_QUERY_EXTENSION_NAME
+	};
+
 	struct QueueFamilyIndices {
 		std::optional<uint32_t> graphicsFamily;
 		std::optional<uint32_t> presentFamily;
+		std::optional<uint32_t> transferFamily;  // transfer only (DMA), optional, uploads fall back to the graphics queue
 
 		bool isComplete() {
 			return graphicsFamily.has_value() && presentFamily.has_value();
@@ -115,7 +144,6 @@ struct Vertex {
 	glm::vec2 texCoord;
 	glm::vec2 texCoord1;
 	glm::vec4 tangent;
-	uint32_t materialIndx;
 
 	static VkVertexInputBindingDescription getBindingDescription() {
 		VkVertexInputBindingDescription bindingDescription = {};
@@ -125,7 +153,7 @@ struct Vertex {
 		return bindingDescription;
 	}
 	static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions() {
-		std::vector<VkVertexInputAttributeDescription> attributeDescriptions(7);
+		std::vector<VkVertexInputAttributeDescription> attributeDescriptions(6);
 
 		attributeDescriptions[0].binding = 0;
 		attributeDescriptions[0].location = 0;
@@ -157,11 +185,6 @@ struct Vertex {
 		attributeDescriptions[5].format = VK_FORMAT_R32G32B32_SFLOAT;
 		attributeDescriptions[5].offset = offsetof(Vertex, tangent);
 
-		attributeDescriptions[6].binding = 0;
-		attributeDescriptions[6].location = 6;
-		attributeDescriptions[6].format = VK_FORMAT_R32_UINT;
-		attributeDescriptions[6].offset = offsetof(Vertex, materialIndx);
-
 		return attributeDescriptions;
 	}
 
@@ -189,16 +212,145 @@ struct stbImageData {
 };
 
 struct AccelerationStructure {
-	VkAccelerationStructureKHR handle;
+	VkAccelerationStructureKHR handle = VK_NULL_HANDLE;
 	uint64_t deviceAddress = 0;
-	VkDeviceMemory memory;
-	VkBuffer buffer;
+	MemoryAllocation memory;
+	VkBuffer buffer = VK_NULL_HANDLE;
+	VkDeviceSize size = 0;  // accelerationStructureSize it was created with
+	VkAccelerationStructureTypeKHR type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+	bool hostVisible = false;  // host built, cloneBLASDeviceLocal moves it before rendering
+};
+
+// how a SceneObject's geometry changes after load, ordered, an object takes the highest of its instances
+enum class ObjectMotion : uint32_t {
+	Static,     // never moves
+	Rigid,      // animated node, the BLAS stays valid and only the TLAS instance moves
+	Deforming,  // skinned or morphed, the BLAS itself has to follow the vertices
+	Count
+};
+
+inline const char* objectMotionName(ObjectMotion motion) {
+	static const char* names[] = { "static", "rigid", "deforming" };
+	return names[static_cast<uint32_t>(motion)];
+}
+
+// BLAS build flags and what happens when the geometry changes, see VulkanASPolicy.hpp
+enum class AsBuildPolicy : uint32_t {
+	Auto,              // picked from the object's motion
+	FastTrace,         // PREFER_FAST_TRACE, rebuilt on change
+	FastTraceCompact,  // PREFER_FAST_TRACE | ALLOW_COMPACTION, copied into a right sized buffer after the build
+	FastTraceUpdate,   // PREFER_FAST_TRACE | ALLOW_UPDATE, refit on change
+	FastBuild,         // PREFER_FAST_BUILD, rebuilt on change
+	FastBuildUpdate,   // PREFER_FAST_BUILD | ALLOW_UPDATE, refit on change
+	Count
+};
+
+inline const char* asBuildPolicyName(AsBuildPolicy policy) {
+	static const char* names[] = { "auto", "fast trace", "fast trace + compact", "fast trace + update", "fast build", "fast build + update" };
+	return names[static_cast<uint32_t>(policy)];
+}
+
+inline VkBuildAccelerationStructureFlagsKHR asBuildFlags(AsBuildPolicy policy) {
+	switch (policy) {
+	case AsBuildPolicy::FastTraceCompact:
+		return VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR;
+	case AsBuildPolicy::FastTraceUpdate:
+		return VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR;
+	case AsBuildPolicy::FastBuild:
+		return VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_BUILD_BIT_KHR;
+	case AsBuildPolicy::FastBuildUpdate:
+		return VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_BUILD_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR;
+	default:
+		return VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+	}
+}
+
+// refit in MODE_UPDATE instead of a rebuild when the geometry changes
+inline bool asBuildRefits(AsBuildPolicy policy) {
+	return (asBuildFlags(policy) & VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR) != 0;
+}
+
+// inputs of one BLAS in a batched build, see VulkanAS.hpp
+struct BlasBuild {
+	VkAccelerationStructureGeometryKHR geometry{};
+	VkAccelerationStructureBuildGeometryInfoKHR buildInfo{};
+	VkAccelerationStructureBuildRangeInfoKHR rangeInfo{};
+	VkDeviceSize scratchSize = 0;
+	VkDeviceSize updateScratchSize = 0;  // 0 unless built with ALLOW_UPDATE
 };
 
+// persistent build scratch, builds of one batch take aligned ranges from head, see VulkanRTDraw.hpp
 struct ScratchBuffer {
 	uint64_t deviceAddress = 0;
 	VkBuffer handle = VK_NULL_HANDLE;
-	VkDeviceMemory memory = VK_NULL_HANDLE;
+	MemoryAllocation memory;
+	VkDeviceSize capacity = 0;
+	VkDeviceSize head = 0;
+	uint64_t grows = 0;     // times a batch needed more than the largest one before it
+	uint64_t ranges = 0;
+};
+
+// submitted copies out of the staging arena, mark is the ring head at submission
+// complete once transferTimeline reaches value
+struct StagingBatch {
+	VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+	uint64_t value = 0;
+	uint64_t mark = 0;
+};
+
+// graphics queue side of an ownership transfer, the command buffer is freed once fence signals
+struct StagingAcquire {
+	VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+	VkFence fence = VK_NULL_HANDLE;
+};
+
+struct StagingStats {
+	uint64_t uploads = 0;
+	uint64_t chunks = 0;
+	uint64_t submits = 0;
+	uint64_t waits = 0;        // times a full arena had to wait for a batch
+	uint64_t acquires = 0;     // graphics submits that waited on the transfer queue
+	VkDeviceSize bytes = 0;
+	VkDeviceSize peakBytes = 0;
+};
+
+// old side of a defragmentation move, destroyed once the pass's fence has signalled
+struct DefragRetired {
+	VkBuffer buffer = VK_NULL_HANDLE;
+	MemoryAllocation memory;
+	VkAccelerationStructureKHR accelerationStructure = VK_NULL_HANDLE;
+};
+
+struct DefragStats {
+	uint64_t passes = 0;
+	uint64_t moves = 0;
+	VkDeviceSize movedBytes = 0;
+	uint64_t stalls = 0;  // passes that moved the TLAS or geometry, the consumer rewrite waits for the queue
+};
+
+// per frame TLAS maintenance, see createTLAS
+struct TlasStats {
+	uint64_t builds = 0;
+	uint64_t refits = 0;
+	uint64_t reallocations = 0;  // instance count outgrew the TLAS, waited for the queue
+	double gpuMs = 0.0;          // last build or refit, timestamps around the command
+	double cpuMs = 0.0;          // instance writes and recording on the host
+};
+
+// updateObjectBLAS calls, shown next to TlasStats
+struct BlasUpdateStats {
+	uint64_t refits = 0;
+	uint64_t rebuilds = 0;       // blasRefitLimit reached or the policy does not refit
+	double lastMs = 0.0;         // wall clock of the last call, it waits for its submission
+};
+
+// one memory heap as seen by VulkanMemoryReport.hpp
+struct HeapBudget {
+	VkDeviceSize size = 0;
+	VkDeviceSize budget = 0;     // 0 when VK_EXT_memory_budget is missing
+	VkDeviceSize usage = 0;
+	VkDeviceSize allocated = 0;  // ours, from memoryManager
+	bool deviceLocal = false;
 };
 
 // mostly extends buffer class
@@ -207,7 +359,7 @@ struct ExtendedvKBuffer {
 	VkStridedDeviceAddressRegionKHR stridedDeviceAddressRegion{};
 	VkDevice* device;
 	VkBuffer buffer = VK_NULL_HANDLE;
-	VkDeviceMemory memory = VK_NULL_HANDLE;
+	MemoryAllocation memory;
 	VkDescriptorBufferInfo descriptor;
 	VkDeviceSize size = 0;
 	VkDeviceSize alignment = 0;
@@ -219,17 +371,17 @@ struct ExtendedvKBuffer {
 	/** @brief Memory property flags to be filled by external source at buffer creation (to query at some later point) */
 	VkMemoryPropertyFlags memoryPropertyFlags;
 
+	// pooled host visible memory is mapped for its whole lifetime, map only hands out the pointer
 	VkResult map(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0) {
-		return vkMapMemory(*device, memory, offset, size, 0, &mapped);
+		if (!memory.mapped) return VK_ERROR_MEMORY_MAP_FAILED;
+		mapped = static_cast<uint8_t*>(memory.mapped) + offset;
+		return VK_SUCCESS;
 	}
 	void unmap() {
-		if (mapped){
-			vkUnmapMemory(*device, memory);
-			mapped = nullptr;
-		}
+		mapped = nullptr;
 	}
 	VkResult bind(VkDeviceSize offset = 0) {
-		return vkBindBufferMemory(*device, buffer, memory, offset);
+		return vkBindBufferMemory(*device, buffer, memory.memory, memory.offset + offset);
 	}
 	void setupDescriptor(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0) {
 		descriptor.offset = offset;
@@ -243,22 +395,24 @@ struct ExtendedvKBuffer {
 	VkResult flush(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0) {
 		VkMappedMemoryRange mappedRange = {};
 		mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-		mappedRange.memory = memory;
-		mappedRange.offset = offset;
-		mappedRange.size = size;
+		mappedRange.memory = memory.memory;
+		mappedRange.offset = memory.offset + offset;
+		mappedRange.size = size == VK_WHOLE_SIZE ? memory.size - offset : size;
 		return vkFlushMappedMemoryRanges(*device, 1, &mappedRange);
 	}
 	VkResult invalidate(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0) {
 		VkMappedMemoryRange mappedRange = {};
 		mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-		mappedRange.memory = memory;
-		mappedRange.offset = offset;
-		mappedRange.size = size;
+		mappedRange.memory = memory.memory;
+		mappedRange.offset = memory.offset + offset;
+		mappedRange.size = size == VK_WHOLE_SIZE ? memory.size - offset : size;
 		return vkInvalidateMappedMemoryRanges(*device, 1, &mappedRange);
 	}
-	void destroy() {
+	void destroy(VulkanMemoryManagementModule& memoryManager) {
 		if (buffer) vkDestroyBuffer(*device, buffer, nullptr);
-		if (memory)vkFreeMemory(*device, memory, nullptr);
+		memoryManager.free(memory);
+		buffer = VK_NULL_HANDLE;
+		mapped = nullptr;
 	}
 };
 
@@ -276,6 +430,37 @@ struct UniformBufferObject {
 	glm::mat4 normalMatrix;
 };
 
+// per frame light block, std140
+struct LightUniformObject {
+	glm::vec4 lightPos;
+	glm::vec4 Ambient;
+	glm::vec4 LightColor;
+	glm::vec4 EyeDirection;
+	glm::mat4 viewMatrix;
+	glm::mat4 eyeViewMatrix;
+	float Reflectivity;
+	float Strength;
+	float ConstantAttenuation;
+	float LinearAttenuation;
+	float QuadraticAttenuation;
+	float padding[3];
+};
+
+// per frame render settings block, std140
+struct RenderSettingsUniform {
+	uint32_t frameIndex;
+	uint32_t vertexLayout;
+	float time;
+	float lodPixelsPerTriangle;
+};
+
+// where this frame's blocks landed in the frame ring, in global set binding order
+struct FrameUniformOffsets {
+	uint32_t camera = 0;
+	uint32_t light = 0;
+	uint32_t settings = 0;
+};
+
 struct RTImageViews {
 	VkImage RTColorImage;
 	VkImageView RTColorImageView;
@@ -303,6 +488,119 @@ struct Material {
 	// this makes it 64 bytes
 };
 
+// slice of the global vertex / index arrays that came from one source mesh
+struct MeshRange {
+	uint32_t firstVertex = 0;
+	uint32_t vertexCount = 0;
+	uint32_t firstIndex = 0;  // indices are already offset by firstVertex
+	uint32_t indexCount = 0;
+	uint32_t materialIndex = 0;
+};
+
+// one node reference of an imported mesh, transform is the node's accumulated world matrix
+struct MeshInstance {
+	glm::mat4 transform = glm::mat4(1.0f);
+	uint32_t mesh = 0;
+	uint32_t motion = 0;  // ObjectMotion, from node animations, skins and morph targets
+	uint32_t padding[2] = {};
+};
+
+// simplified level of a mesh, indexes the same vertices as the mesh's MeshRange (level 0)
+struct MeshLod {
+	uint32_t mesh = 0;
+	uint32_t level = 0;
+	uint32_t firstIndex = 0;
+	uint32_t indexCount = 0;
+	float error = 0.0f;  // rms distance of the worst collapse, model units
+};
+
+// cpu side geometry handed to the buffer uploads, points either at the imported arrays or into a mapped scene cache
+struct GeometryView {
+	const Vertex* vertices = nullptr;
+	size_t vertexCount = 0;
+	const uint32_t* indices = nullptr;
+	size_t indexCount = 0;
+};
+
+// layout of the vertex stream the hit shaders read
+enum class VertexLayout {
+	Full,    // Vertex as imported
+	Compact  // CompactVertex, decoded in the hit shaders with shaders/RT_vertex_decode.glsl
+};
+
+// Vertex without pos, the full layout uploads this when the positions have their own stream (splitPositionStream)
+struct VertexAttributes {
+	glm::vec3 color;
+	glm::vec3 normal;
+	glm::vec2 texCoord;
+	glm::vec2 texCoord1;
+	glm::vec4 tangent;
+
+	VertexAttributes() = default;
+	explicit VertexAttributes(const Vertex& v) : color(v.color), normal(v.normal), texCoord(v.texCoord), texCoord1(v.texCoord1), tangent(v.tangent) {}
+
+	// binding 0 these attributes, binding 1 the packed positions, the locations stay those of Vertex
+	static std::array<VkVertexInputBindingDescription, 2> getBindingDescriptions() {
+		std::array<VkVertexInputBindingDescription, 2> bindingDescriptions = {};
+		bindingDescriptions[0] = { 0, sizeof(VertexAttributes), VK_VERTEX_INPUT_RATE_VERTEX };
+		bindingDescriptions[1] = { 1, sizeof(glm::vec3), VK_VERTEX_INPUT_RATE_VERTEX };
+		return bindingDescriptions;
+	}
+	static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions() {
+		return {
+			{ 0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(VertexAttributes, color) },
+			{ 1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(VertexAttributes, normal) },
+			{ 2, 1, VK_FORMAT_R32G32B32_SFLOAT, 0 },
+			{ 3, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(VertexAttributes, texCoord) },
+			{ 4, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(VertexAttributes, texCoord1) },
+			{ 5, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(VertexAttributes, tangent) }
+		};
+	}
+};
+
+// 20 byte hit shading vertex, the BLAS is built from a separate float position stream
+struct CompactVertex {
+	uint16_t pos[3];    // unorm16 inside the bounds of its mesh
+	uint16_t mesh;      // index into the MeshInfo buffer
+	uint32_t normal;    // octahedral snorm16x2
+	uint32_t tangent;   // octahedral snorm16x2, lowest bit set for negative handedness
+	uint32_t texCoord;  // half2
+};
+
+// per mesh constants for decoding CompactVertex, laid out for std430
+struct MeshInfo {
+	glm::vec3 boundsMin;
+	uint32_t materialIndex;
+	glm::vec3 boundsScale;  // bounds extent / 65535
+	uint32_t firstIndex;
+};
+
+// knobs for how MODEL_PATH is turned into gpu geometry, set before setup()
+struct SceneLoadOptions {
+	bool useSceneCache = true;  // cook to / load from <model>.rtcache
+	bool nativeGLB = true;      // read .glb files directly, Assimp stays the fallback
+	VertexLayout vertexLayout = VertexLayout::Full;
+	bool splitPositionStream = true;  // positions in their own packed float3 stream (the BLAS input), the vertex buffer keeps the rest
+	bool optimizeMeshes = false;      // Morton sort triangles and renumber vertices in first use order after import
+	uint32_t lodLevels = 0;           // simplified levels per mesh, each about half the triangles of the previous one
+	float lodPixelsPerTriangle = 4.0f;  // projected area a triangle should cover before a coarser level is picked
+	bool asyncLoad = true;            // load the model on a background thread while vulkan initializes
+	bool batchUploads = true;         // scene uploads share staging submissions, off submits once per buffer for comparison
+	bool compactBLAS = true;          // BLAS are built with ALLOW_COMPACTION and copied into right sized buffers
+	uint32_t tlasRefitLimit = 64;     // TLAS refits in a row before a full build restores trace quality, 0 always rebuilds
+	uint32_t blasRefitLimit = 16;     // refits of a deforming BLAS before updateObjectBLAS builds it again
+	std::unordered_map<std::string, AsBuildPolicy> buildPolicyOverrides;  // by SceneObject name ("mesh 3"), replaces the classified policy
+	bool hostBLASBuilds = true;       // build the BLAS on the cpu threads where the device has accelerationStructureHostCommands
+};
+
+// one BLAS of a SceneObject's LOD chain, level 0 is the imported mesh
+struct LodLevel {
+	uint32_t firstIndex = 0;
+	uint32_t indexCount = 0;
+	uint32_t meshInfoIndex = 0;  // gl_InstanceCustomIndexEXT of an instance using this level
+	AccelerationStructure blas;
+};
+
 struct SceneObject {
 	std::string name;
 	uint64_t id; // hash key
@@ -313,12 +611,28 @@ struct SceneObject {
 
 	ExtendedvKBuffer vertexBuffer;
 	ExtendedvKBuffer indexBuffer;
-	AccelerationStructure blas; 
+	AccelerationStructure blas;  // lods[0].blas
+
+	MeshRange range;             // slice of the shared vertex / index buffers
+	uint32_t geometryIndex = 0;  // imported mesh index, also its level 0 MeshInfo entry
+	std::vector<LodLevel> lods;
+	glm::vec3 boundsCenter = glm::vec3(0.0f);  // object space bounding sphere for the LOD pick
+	float boundsRadius = 0.0f;
+	ObjectMotion motion = ObjectMotion::Static;
+	AsBuildPolicy buildPolicy = AsBuildPolicy::Auto;  // resolved by assignBuildPolicies before the BLAS are built
+	uint32_t blasRefits = 0;                          // updateObjectBLAS refits since the last build
 
 	Material material;
 	glm::mat4 transform; 
 };
 
+// placement of a SceneObject in the TLAS, every instance of an object shares its BLAS chain
+struct SceneInstance {
+	uint64_t objectId = 0;
+	glm::mat4 transform = glm::mat4(1.0f);
+	uint32_t lod = 0;  // level the TLAS currently instances
+};
+
 struct Light {
 	glm::vec3 position;
 	glm::vec3 color;
@@ -328,12 +642,20 @@ struct Light {
 class Scene {
 public:
 	std::unordered_map<uint64_t, SceneObject> objects;
+	std::vector<SceneInstance> instances;
 	std::vector<Light> lights;
 
 	void addObject(const SceneObject& obj) {
 		objects[obj.id] = obj;
 	}
 
+	void addInstance(uint64_t objectId, const glm::mat4& transform) {
+		SceneInstance instance;
+		instance.objectId = objectId;
+		instance.transform = transform;
+		instances.push_back(instance);
+	}
+
 	SceneObject* getObjectByName(const std::string& name) {
 		uint64_t id = std::hash<std::string>{}(name);
 		if (objects.find(id) != objects.end()) {
@@ -362,6 +684,8 @@ public:
 	static MainVulkApplication* GetInstance();
 
 	void setup(std::string appName = "") {
+		// parsing and converting the model needs no device, it runs while the window and vulkan objects are created
+		startAssetLoad();
 		initWindow();
 		initVulkan(appName);
 	}
@@ -370,6 +694,10 @@ public:
 		cleanup();
 	}
 
+	void setLoadOptions(const SceneLoadOptions& options) {
+		loadOptions = options;
+	}
+
 private:
 
 	static MainVulkApplication* pinstance_;
@@ -389,6 +717,10 @@ private:
 
 	VkQueue graphicsQueue;
 	VkQueue presentQueue;
+	VkQueue transferQueue = VK_NULL_HANDLE;  // graphicsQueue when the device has no transfer only family
+	uint32_t graphicsFamilyIndex = 0;
+	uint32_t transferFamilyIndex = 0;
+	VkExtent3D transferImageGranularity = { 1, 1, 1 };
 
 	VkSwapchainKHR swapChain;
 	std::vector<VkImage> swapChainImages;
@@ -398,7 +730,7 @@ private:
 	std::vector<VkFramebuffer> swapChainFramebuffers;
 
 	VkImage depthImage;
-	VkDeviceMemory depthImageMemory;
+	VkDeviceMemory depthImageMemory = VK_NULL_HANDLE;
 	VkImageView depthImageView;
 
 	VkRenderPass renderPass;
@@ -416,20 +748,62 @@ private:
 
 	VkCommandPool commandPool;
 
-	std::vector<VkBuffer> uniformBuffers;
-	std::vector<VkDeviceMemory> uniformBuffersMemory;
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	std::vector<MeshRange> meshRanges;
+	std::vector<MeshLod> meshLods;
+	std::vector<MeshInstance> meshInstances;
+	std::vector<Material> materials;
+
+	SceneLoadOptions loadOptions;
+	GeometryView geometry;
+	std::unique_ptr<MappedFile> sceneCacheFile;
+
+	VkBuffer vertexBuffer = VK_NULL_HANDLE;
+	MemoryAllocation vertexBufferMemory;
+	VkBuffer indexBuffer = VK_NULL_HANDLE;
+	MemoryAllocation indexBufferMemory;
+
+	// layout actually uploaded, compact falls back to full when a scene does not fit it
+	// positionBuffer is the BLAS input whenever it exists, vertexBuffer then only feeds shading,
+	// with the full layout it then holds VertexAttributes instead of Vertex
+	VertexLayout vertexLayout = VertexLayout::Full;
+	std::vector<MeshInfo> meshInfos;
+	VkBuffer positionBuffer = VK_NULL_HANDLE;
+	MemoryAllocation positionBufferMemory;
+	VkBuffer meshInfoBuffer = VK_NULL_HANDLE;
+	MemoryAllocation meshInfoBufferMemory;
+
+	// one object per unique mesh that a node references, all sharing the buffers above, placed by scene.instances
+	Scene scene;
+
+	// cpu workers for asset work, created on first use
+	std::unique_ptr<ThreadPool> workerPool;
+
+	// background loadModel started by setup(), owns every cpu side scene member until waitForAssets joins it
+	std::future<void> assetLoad;
+	std::chrono::high_resolution_clock::time_point assetLoadStart;
+	std::chrono::high_resolution_clock::time_point assetLoadEnd;
+
+	// one host coherent buffer, persistently mapped, a slice per frame in flight that updateUniformBuffer bump allocates from
+	VkBuffer frameUniformBuffer = VK_NULL_HANDLE;
+	MemoryAllocation frameUniformMemory;
+	FrameRingAllocator frameUniformRing;
+	FrameUniformOffsets frameUniformOffsets;
 
 	std::vector<VkBuffer> uniformFragBuffers;
-	std::vector<VkDeviceMemory> uniformFragBuffersMemory;
+	std::vector<MemoryAllocation> uniformFragBuffersMemory;
 
 	std::vector<VkBuffer> uniformDynamicBuffers;
-	std::vector<VkDeviceMemory> uniformDynamicBuffersMemory;
+	std::vector<MemoryAllocation> uniformDynamicBuffersMemory;
 
 	VkDescriptorPool descriptorPool;
 	VkDescriptorPool descriptorPoolIMGui;
 	std::vector<VkDescriptorSet> descriptorSets;
 
-	UniformBufferObject ubo;
+	UniformBufferObject ubo{};
+	LightUniformObject ufo{};
+	RenderSettingsUniform renderSettings{};
 
 	std::vector<VkCommandBuffer> commandBuffers;
 
@@ -438,6 +812,9 @@ private:
 	std::vector<VkFence> inFlightFences;
 
 	size_t currentFrame = 0;
+	// transient host data of the frame being recorded, rewound after its fence, see FrameArena.h
+	std::array<FrameArena, MAX_FRAMES_IN_FLIGHT> frameArenas;
+	FrameArena& frameArena() { return frameArenas[currentFrame]; }
 
 	bool framebufferResized = false;
 
@@ -457,6 +834,7 @@ private:
 	accelerationStructureHostCommands : Allows AS builds from the CPU instead of GPU.
 	*/
 	VkPhysicalDeviceAccelerationStructureFeaturesKHR accelerationStructureFeatures{};
+	VkPhysicalDeviceAccelerationStructurePropertiesKHR accelerationStructureProperties{};
 
 	// Enabled features and properties
 	/*
@@ -473,6 +851,49 @@ private:
 	*/
 	VkPhysicalDeviceRayTracingPipelineFeaturesKHR enabledRayTracingPipelineFeatures{};
 	VkPhysicalDeviceAccelerationStructureFeaturesKHR enabledAccelerationStructureFeatures{};
+	// uploads signal a timeline value, the graphics queue waits on it only when it consumes them
+	VkPhysicalDeviceTimelineSemaphoreFeatures enabledTimelineSemaphoreFeatures{};
+
+	// every buffer is sub-allocated from here, images keep their own vkAllocateMemory but are registered with it
+	VulkanMemoryManagementModule memoryManager;
+	bool memoryBudgetSupported = false;     // VK_EXT_memory_budget, per heap budget and usage from the driver
+	// VK_KHR_ray_query, only the build policy benchmark traces with it
+	VkPhysicalDeviceRayQueryFeaturesKHR enabledRayQueryFeatures{};
+	bool rayQuerySupported = false;
+	// accelerationStructureHostCommands, cpu implementations (lavapipe) report it, see buildBLASHost
+	bool hostBuildSupported = false;
+	bool showMemoryPanel = true;
+
+	// persistent upload ring, see VulkanStaging.hpp
+	VkBuffer stagingBuffer = VK_NULL_HANDLE;
+	MemoryAllocation stagingMemory;
+	StagingRing stagingRing;
+	VkCommandPool transferCommandPool = VK_NULL_HANDLE;
+	VkCommandBuffer stagingCommandBuffer = VK_NULL_HANDLE;  // open batch, recorded until flushStaging
+	std::deque<StagingBatch> stagingInFlight;
+	VkSemaphore transferTimeline = VK_NULL_HANDLE;
+	uint64_t transferSignalled = 0;                         // value of the last submitted batch
+	uint64_t transferAcquired = 0;                          // last value the graphics queue waited for
+	std::vector<VkBufferMemoryBarrier> stagingBufferReleases;  // destinations finished in the open batch
+	std::vector<VkImageMemoryBarrier> stagingImageReleases;
+	std::vector<VkBufferMemoryBarrier> pendingBufferAcquires;  // released, not yet acquired by the graphics queue
+	std::vector<VkImageMemoryBarrier> pendingImageAcquires;
+	std::deque<StagingAcquire> stagingAcquires;
+	std::vector<VkFence> stagingFences;                     // unsignalled, ready for the next acquire
+	VkFence singleTimeFence = VK_NULL_HANDLE;
+	uint32_t uploadBatchDepth = 0;                          // open upload batches, finishUpload only submits outside them
+	StagingStats stagingStats;
+
+	// incremental defragmentation of the device local pools, see VulkanDefrag.hpp
+	bool defragEnabled = true;
+	VkDeviceSize defragBytesPerFrame = 8ull * 1024 * 1024;
+	VkCommandBuffer defragCommandBuffer = VK_NULL_HANDLE;
+	VkFence defragFence = VK_NULL_HANDLE;
+	bool defragInFlight = false;
+	std::vector<DefragRetired> defragRetired;
+	uint64_t defragIdleAt = UINT64_MAX;  // allocations + frees when the last scan found nothing to move
+	DefragStats defragStats;
+	bool tlasDirty = false;              // a BLAS moved, the instances hold stale references
 
 	std::vector<VkRayTracingShaderGroupCreateInfoKHR> shaderGroups = {};
 
@@ -480,6 +901,26 @@ private:
 	AccelerationStructure topLevelAS;
 	ScratchBuffer scratchBuffer;
 
+	// one VkAccelerationStructureInstanceKHR per SceneInstance and frame in flight, host visible and mapped for the lifetime of the TLAS
+	std::array<VkBuffer, MAX_FRAMES_IN_FLIGHT> tlasInstanceBuffers{};
+	std::array<MemoryAllocation, MAX_FRAMES_IN_FLIGHT> tlasInstanceBufferMemory{};
+	std::array<VkCommandBuffer, MAX_FRAMES_IN_FLIGHT> tlasCommandBuffers{};
+	std::array<bool, MAX_FRAMES_IN_FLIGHT> tlasTimestamped{};
+	ScratchBuffer tlasScratch;            // its own, builds in flight never see the pool regrow under them
+	VkQueryPool tlasQueryPool = VK_NULL_HANDLE;
+	double tlasTickMs = 0.0;
+	uint32_t tlasInstanceCapacity = 0;    // instances the TLAS and its buffers were sized for
+	uint32_t tlasBuiltInstances = 0;      // primitive count of the last full build, a refit has to match it
+	uint32_t tlasRefits = 0;              // refits since the last full build
+	bool tlasTransformsDirty = false;     // moveInstance changed a transform, a refit is enough
+	TlasStats tlasStats;
+	// debug driver of the refit path, the first animatedInstances placements circle through moveInstance every frame
+	uint32_t animatedInstances = 0;
+	std::vector<glm::mat4> animationBaseTransforms;  // their loaded transforms, restored when the count drops
+	// debug driver of the BLAS update path, the first deformedObjects updatable objects go through updateObjectBLAS every frame
+	uint32_t deformedObjects = 0;
+	BlasUpdateStats blasUpdateStats;
+
 	// Function pointers for ray tracing related stuff
 	PFN_vkGetBufferDeviceAddressKHR vkGetBufferDeviceAddressKHR;
 	PFN_vkCreateAccelerationStructureKHR vkCreateAccelerationStructureKHR;
@@ -488,6 +929,13 @@ private:
 	PFN_vkGetAccelerationStructureDeviceAddressKHR vkGetAccelerationStructureDeviceAddressKHR;
 	PFN_vkBuildAccelerationStructuresKHR vkBuildAccelerationStructuresKHR;
 	PFN_vkCmdBuildAccelerationStructuresKHR vkCmdBuildAccelerationStructuresKHR;
+	PFN_vkCmdCopyAccelerationStructureKHR vkCmdCopyAccelerationStructureKHR;
+	PFN_vkCmdWriteAccelerationStructuresPropertiesKHR vkCmdWriteAccelerationStructuresPropertiesKHR;
+	PFN_vkCreateDeferredOperationKHR vkCreateDeferredOperationKHR;
+	PFN_vkDestroyDeferredOperationKHR vkDestroyDeferredOperationKHR;
+	PFN_vkGetDeferredOperationMaxConcurrencyKHR vkGetDeferredOperationMaxConcurrencyKHR;
+	PFN_vkGetDeferredOperationResultKHR vkGetDeferredOperationResultKHR;
+	PFN_vkDeferredOperationJoinKHR vkDeferredOperationJoinKHR;
 	PFN_vkCmdTraceRaysKHR vkCmdTraceRaysKHR;
 	PFN_vkGetRayTracingShaderGroupHandlesKHR vkGetRayTracingShaderGroupHandlesKHR;
 	PFN_vkCreateRayTracingPipelinesKHR vkCreateRayTracingPipelinesKHR;
@@ -509,6 +957,7 @@ private:
 	void getEnabledFeatures();
 	QueueFamilyIndices findQueueFamilies(VkPhysicalDevice );
 	bool checkDeviceExtensionSupport(VkPhysicalDevice );
+	bool deviceExtensionAvailable(VkPhysicalDevice, const char*);
 
 	VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& );
 	void createSwapChain();
@@ -518,7 +967,9 @@ private:
 	void createImageViews();
 	VkImageView createImageView(VkImage, VkFormat, VkImageAspectFlags);
 	void createImage(uint32_t, uint32_t,
-		VkFormat, VkImageTiling, VkImageUsageFlags, VkMemoryPropertyFlags, VkImage&, VkDeviceMemory&);
+		VkFormat, VkImageTiling, VkImageUsageFlags, VkMemoryPropertyFlags, VkImage&, VkDeviceMemory&,
+		MemoryCategory = MemoryCategory::Texture);
+	void freeImageMemory(VkDeviceMemory&);
 	uint32_t findMemoryType(uint32_t, VkMemoryPropertyFlags);
 
 	VkFormat findDepthFormat();
@@ -531,14 +982,48 @@ private:
 
 	void createVertexBuffer();
 	void createBuffer(VkDeviceSize, VkBufferUsageFlags,
-		VkMemoryPropertyFlags, VkBuffer&, VkDeviceMemory&, bool );
+		VkMemoryPropertyFlags, VkBuffer&, MemoryAllocation&, bool = false, MemoryCategory = MemoryCategory::Other);
+	void destroyBuffer(VkBuffer&, MemoryAllocation&);
+	void createStagingArena();
+	void destroyStagingArena();
+	void retireStaging(bool);
+	VkDeviceSize acquireStaging(VkDeviceSize);
+	VkCommandBuffer openStaging();
+	void releaseStagedBuffer(VkBuffer);
+	void releaseStagedImage(VkImage, VkImageLayout);
+	void acquireStaged();
+	void stageToBuffer(VkBuffer, VkDeviceSize, const void*, VkDeviceSize);
+	void flushStaging();
+	void waitStaging();
+	void beginUploadBatch();
+	void endUploadBatch(bool = false);
+	void finishUpload();
+	void defragmentStep();
+	void retireDefrag();
+	void refreshGeometryConsumers();
+	void destroyDefrag();
+	VkBuffer createRelocatedBuffer(const MemoryAllocation&, MemoryAllocation&);
+	bool relocateBuffer(VkBuffer&, MemoryAllocation&);
+	bool relocateAccelerationStructure(AccelerationStructure&);
+	void writeTlasDescriptor();
+	void reportSceneMemory(const MemoryPoolStats&, std::chrono::high_resolution_clock::time_point);
 	void createIndexBuffer();
+	bool createCompactVertexBuffer();
+	void createMeshInfoBuffer();
+	void buildSceneObjects();
+	void createPositionBuffer();
+	void uploadBuffer(VkDeviceSize, VkBufferUsageFlags, VkBuffer&, MemoryAllocation&, MemoryCategory, const std::function<void(void*)>&);
+	VkDeviceAddress GetBufferDeviceAddress(VkBuffer);
 	void createUniformBuffers();
+	void bindFrameUniforms(VkCommandBuffer, VkPipelineBindPoint, VkPipelineLayout, uint32_t);
 	void createDescriptorPool();
 	void createDescriptorSets();
 	
 	void createImguiContext();
 	void render_gui();
+	FrameVector<HeapBudget> queryHeapBudgets();
+	void drawMemoryPanel();
+	void dumpMemoryReport(const std::string&);
 	void drawImgFrame(VkCommandBuffer& );
 
 	void copyBuffer(VkBuffer, VkBuffer, VkDeviceSize);
@@ -553,15 +1038,48 @@ private:
 	void cleanupSwapChain();
 
 	void loadModel();
+	void startAssetLoad();
+	void waitForAssets();
+	void benchmarkModelImport();
+	bool loadSceneCache(uint64_t, uint64_t, uint32_t);
+	void writeSceneCache(uint64_t, uint64_t, uint32_t);
+	void releaseSceneCache();
 	void createTextureImage();
-	void copyBufferToImage(VkBuffer , VkImage , uint32_t , uint32_t );
+	void copyBufferToImage(VkCommandBuffer, VkBuffer, VkDeviceSize, VkImage, uint32_t, uint32_t, uint32_t);
 	void transitionImageLayout(VkImage, VkFormat, VkImageLayout, VkImageLayout);
+	void transitionImageLayout(VkCommandBuffer, VkImage, VkFormat, VkImageLayout, VkImageLayout);
 	void createTextureImageView();
 	void createTextureSampler();
 	void setupAS();
 	void createBLAS();
+	void prepareBLAS(const SceneObject&, LodLevel&, BlasBuild&, AsBuildPolicy = AsBuildPolicy::Auto, bool host = false);
+	uint32_t buildBLASBatches(std::vector<BlasBuild>&, VkQueryPool = VK_NULL_HANDLE, VkQueryPool = VK_NULL_HANDLE);
+	uint32_t buildBLASHost(std::vector<BlasBuild>&, uint32_t threads = 0);
+	void compactBLAS(const std::vector<LodLevel*>&, VkQueryPool);
+	void cloneBLASDeviceLocal(const std::vector<LodLevel*>&);
+	void assignBuildPolicies();
+	void updateObjectBLAS(SceneObject&);
+	void deformObjects();
+	glm::mat4 instanceWorld(const SceneInstance&) const;
+	bool selectLods();
+	void moveInstance(uint32_t, const glm::mat4&);
+	void animateInstances(float);
 	void createTLAS();
+	void destroyTLAS();
+	void destroyAccelerationStructure(AccelerationStructure&);
 	void createSBT();
+	void createAccelerationStructure(AccelerationStructure&, VkAccelerationStructureTypeKHR, VkAccelerationStructureBuildSizesInfoKHR, bool hostVisible = false);
+	VkDeviceSize scratchFootprint(VkDeviceSize);
+	void resetScratch(VkDeviceSize);
+	VkDeviceAddress allocateScratch(VkDeviceSize);
+	void benchmarkBLASInputLayouts();
+	void benchmarkASBuildPolicies();
+	void benchmarkHostASBuilds();
+
+	// imported triangles only, LOD levels sit behind them in the index buffer
+	uint32_t sceneIndexCount() const {
+		return meshRanges.empty() ? 0 : meshRanges.back().firstIndex + meshRanges.back().indexCount;
+	}
 	void createShaderBindingTable(ExtendedvKBuffer&, uint32_t);
 
 	void initVulkan(std::string appName ) {
@@ -575,21 +1093,39 @@ private:
 		getEnabledFeatures();
 		
 		createLogicalDevice();
+		memoryManager.init(physicalDevice, device);
 		createSwapChain();
 		createImageViews();
 		createDescriptorSetLayout();
 		createGraphicsPipeline();
 		createCommandPool();
+		createStagingArena();
 		//createTextureImage();
 		//createTextureImageView();
 		//createTextureSampler();
 
-		loadModel();
+		waitForAssets();
+		if (enableBenchmarks) benchmarkModelImport();
+		const MemoryPoolStats sceneMemoryStart = memoryManager.getStats();
+		const auto sceneUploadStart = std::chrono::high_resolution_clock::now();
+		beginUploadBatch();
 		createVertexBuffer();
 		createIndexBuffer();
+		endUploadBatch();
+		buildSceneObjects();
+		assignBuildPolicies();
+		if (enableBenchmarks) benchmarkBLASInputLayouts();
+		if (enableBenchmarks) benchmarkASBuildPolicies();
+		if (enableBenchmarks) benchmarkHostASBuilds();
+		// host builds read the cpu geometry, the cache mapping has to outlive them
+		createBLAS();
+		releaseSceneCache();
+		createTLAS();
+		reportSceneMemory(sceneMemoryStart, sceneUploadStart);
 		createUniformBuffers();
 		createDescriptorPool();
-		//createDescriptorSets();
+		// bindFrameUniforms indexes globalDescriptorSet from the first frame on
+		createDescriptorSets();
 		createImguiContext();
 		createCommandBuffers();
 		createSyncObjects();
@@ -611,22 +1147,26 @@ private:
 		vkDestroyImageView(device, textureImageView, nullptr);
 
 		vkDestroyImage(device, textureImage, nullptr);
-		vkFreeMemory(device, textureImageMemory, nullptr);
+		freeImageMemory(textureImageMemory);
 
 		vkDestroyDescriptorPool(device, descriptorPool, nullptr);
 
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 
-		for (size_t i = 0; i < swapChainImages.size(); i++) {
-			vkDestroyBuffer(device, uniformBuffers[i], nullptr);
-			vkFreeMemory(device, uniformBuffersMemory[i], nullptr);
-		}
-
-		vkDestroyBuffer(device, indexBuffer, nullptr);
-		vkFreeMemory(device, indexBufferMemory, nullptr);
-
-		vkDestroyBuffer(device, vertexBuffer, nullptr);
-		vkFreeMemory(device, vertexBufferMemory, nullptr);
+		destroyBuffer(frameUniformBuffer, frameUniformMemory);
+
+		destroyBuffer(indexBuffer, indexBufferMemory);
+		destroyBuffer(vertexBuffer, vertexBufferMemory);
+		destroyBuffer(positionBuffer, positionBufferMemory);
+		for (auto& entry : scene.objects)
+			for (LodLevel& level : entry.second.lods) destroyAccelerationStructure(level.blas);
+		destroyAccelerationStructure(bottomLevelAS);
+		destroyTLAS();
+		if (tlasQueryPool != VK_NULL_HANDLE) vkDestroyQueryPool(device, tlasQueryPool, nullptr);
+		destroyBuffer(scratchBuffer.handle, scratchBuffer.memory);
+		destroyBuffer(meshInfoBuffer, meshInfoBufferMemory);
+		for (ExtendedvKBuffer* table : { &shaderBindingTables.raygen, &shaderBindingTables.miss, &shaderBindingTables.hit, &shaderBindingTables.callable })
+			if (table->buffer != VK_NULL_HANDLE) table->destroy(memoryManager);
 
 		
 		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
@@ -635,8 +1175,11 @@ private:
 			vkDestroyFence(device, inFlightFences[i], nullptr);
 		}
 
+		destroyDefrag();
+		destroyStagingArena();
 		vkDestroyCommandPool(device, commandPool, nullptr);
 
+		memoryManager.destroy();
 		vkDestroyDevice(device, nullptr);
 
 		if (enableValidationLayers) {
@@ -677,14 +1220,24 @@ namespace std {
 #include "VulkanDevice.hpp"
 #include "VulkanWindow.hpp"
 #include "VulkanSwapchain.hpp"
+#include "VulkanStaging.hpp"
+#include "VulkanDefrag.hpp"
 #include "VulkanDraw.hpp"
 #include "VulkanRenderSettings.hpp"
 #include "VulkanSync.hpp"
+#include "VulkanSceneCache.hpp"
+#include "VulkanGLB.hpp"
+#include "VulkanMeshOptimize.hpp"
+#include "VulkanMeshSimplify.hpp"
 #include "VulkanGeometry.hpp"
+#include "VulkanVertexFormat.hpp"
 #include "VulkanTexture.hpp"
 #include "VulkanRTDraw.hpp"
+#include "VulkanMemoryReport.hpp"
 #include "VulkanImgui.hpp"
+#include "VulkanASPolicy.hpp"
 #include "VulkanAS.hpp"
 #include "VulkanSBT.hpp"
+#include "VulkanBenchmark.hpp"
 
 #endif
\ No newline at end of file
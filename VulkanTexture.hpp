@@ -12,25 +12,29 @@ namespace VkApplication {
             throw std::runtime_error("failed to load texture image!");
         }
 
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingBufferMemory;
-        createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-
-        void* data;
-        vkMapMemory(device, stagingBufferMemory, 0, imageSize, 0, &data);
-        memcpy(data, pixels, static_cast<size_t>(imageSize));
-        vkUnmapMemory(device, stagingBufferMemory);
-
-        stbi_image_free(pixels);
-
         createImage(texWidth, texHeight, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureImage, textureImageMemory);
 
-        transitionImageLayout(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-        copyBufferToImage(stagingBuffer, textureImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
-        transitionImageLayout(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        // recorded in the staging batch, the image starts out on the queue that copies into it
+        transitionImageLayout(openStaging(), textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+        // whole rows through the staging arena, bands of a quarter arena so a big texture never waits on itself
+        // bands start at multiples of the transfer family's granularity, createLogicalDevice never leaves it at 0
+        // (whole mips only), 0 is taken as any row count so a band can not outgrow the arena
+        const VkDeviceSize rowBytes = static_cast<VkDeviceSize>(texWidth) * 4;
+        const uint32_t granularity = std::max(1u, transferImageGranularity.height);
+        uint32_t bandRows = static_cast<uint32_t>(std::max<VkDeviceSize>(1, (STAGING_ARENA_SIZE / 4) / rowBytes));
+        if (bandRows > granularity) bandRows -= bandRows % granularity;
+        else bandRows = granularity;
+        for (uint32_t row = 0; row < static_cast<uint32_t>(texHeight); row += bandRows) {
+            const uint32_t rows = std::min(bandRows, static_cast<uint32_t>(texHeight) - row);
+            const VkDeviceSize offset = acquireStaging(rowBytes * rows);
+            memcpy(static_cast<uint8_t*>(stagingMemory.mapped) + offset, pixels + rowBytes * row, static_cast<size_t>(rowBytes * rows));
+            copyBufferToImage(stagingCommandBuffer, stagingBuffer, offset, textureImage, static_cast<uint32_t>(texWidth), row, rows);
+        }
+        releaseStagedImage(textureImage, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        finishUpload();
 
-        vkDestroyBuffer(device, stagingBuffer, nullptr);
-        vkFreeMemory(device, stagingBufferMemory, nullptr);
+        stbi_image_free(pixels);
     }
 
     void MainVulkApplication::createTextureSampler() {
@@ -57,32 +61,37 @@ namespace VkApplication {
         }
     }
 
-    void MainVulkApplication::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height) {
-        VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+    // rows [firstRow, firstRow + rows) of mip 0, recorded into commandBuffer
+    void MainVulkApplication::copyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize bufferOffset,
+        VkImage image, uint32_t width, uint32_t firstRow, uint32_t rows) {
 
         VkBufferImageCopy region{};
-        region.bufferOffset = 0;
+        region.bufferOffset = bufferOffset;
         region.bufferRowLength = 0;
         region.bufferImageHeight = 0;
         region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
         region.imageSubresource.mipLevel = 0;
         region.imageSubresource.baseArrayLayer = 0;
         region.imageSubresource.layerCount = 1;
-        region.imageOffset = { 0, 0, 0 };
+        region.imageOffset = { 0, static_cast<int32_t>(firstRow), 0 };
         region.imageExtent = {
             width,
-            height,
+            rows,
             1
         };
 
         vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-
-        endSingleTimeCommands(commandBuffer);
     }
 
+    // one shot, waits for the transition, batch them with the overload below where possible
     void MainVulkApplication::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout) {
         VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+        transitionImageLayout(commandBuffer, image, format, oldLayout, newLayout);
+        endSingleTimeCommands(commandBuffer);
+    }
 
+    void MainVulkApplication::transitionImageLayout(VkCommandBuffer commandBuffer, VkImage image, VkFormat format,
+        VkImageLayout oldLayout, VkImageLayout newLayout) {
         VkImageMemoryBarrier barrier = {};
         barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
         barrier.oldLayout = oldLayout;
@@ -179,8 +188,6 @@ namespace VkApplication {
         else throw std::invalid_argument("unsupported layout transition!");
       
         vkCmdPipelineBarrier( commandBuffer, sourceStage, destinationStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
-
-        endSingleTimeCommands(commandBuffer);
     }
 
     void MainVulkApplication::createTextureImageView() {
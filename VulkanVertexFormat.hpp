@@ -0,0 +1,159 @@
+#ifndef __VK_VERTEX_FORMAT_HPP__
+#define __VK_VERTEX_FORMAT_HPP__
+
+/*
+Compact vertex encoding, selected with SceneLoadOptions::vertexLayout.
+
+	Vertex            68 bytes  color, normal, pos, 2 uv sets, tangent
+	VertexAttributes  56 bytes  Vertex without pos, the full layout with splitPositionStream
+	CompactVertex     20 bytes  pos unorm16 x3 + mesh, oct normal, oct tangent, half2 uv
+	position          12 bytes  float3, BLAS input
+
+Positions are quantized inside the bounds of their mesh, the bounds and the mesh material live once per mesh
+in the MeshInfo buffer, which both layouts upload since the hit shaders find their material through it. Decoding is done by the hit shaders, shaders/RT_vertex_decode.glsl mirrors this file.
+*/
+
+// the table above, logs and reports print sizeof so only these have to follow a layout change
+static_assert(sizeof(Vertex) == 68, "update the vertex size table");
+static_assert(sizeof(VertexAttributes) == 56, "update the vertex size table");
+static_assert(sizeof(CompactVertex) == 20, "CompactVertex must match RT_vertex_decode.glsl");
+
+namespace VkApplication {
+
+	constexpr float QUANTIZE_MAX = 65535.0f;
+
+	glm::vec2 octEncode(glm::vec3 n) {
+		float l1 = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+		if (l1 <= 0.0f) return glm::vec2(0.0f);
+		glm::vec2 p = glm::vec2(n.x, n.y) / l1;
+		// lower hemisphere folds over the diagonals
+		if (n.z < 0.0f)
+			p = glm::vec2((1.0f - fabsf(p.y)) * (p.x >= 0.0f ? 1.0f : -1.0f), (1.0f - fabsf(p.x)) * (p.y >= 0.0f ? 1.0f : -1.0f));
+		return p;
+	}
+
+	uint32_t packOctNormal(const glm::vec3& n) {
+		return glm::packSnorm2x16(octEncode(n));
+	}
+
+	// the lowest bit of x gives up one step of precision to carry the bitangent sign
+	uint32_t packOctTangent(const glm::vec4& t) {
+		return (glm::packSnorm2x16(octEncode(glm::vec3(t))) & ~1u) | (t.w < 0.0f ? 1u : 0u);
+	}
+
+	// bounds and material per mesh, a degenerate axis keeps a tiny extent so the decode never divides by zero
+	// LOD levels follow the meshes, same bounds and material with their own first index
+	void buildMeshInfos(const GeometryView& geometry, const std::vector<MeshRange>& meshRanges, const std::vector<MeshLod>& meshLods,
+		std::vector<MeshInfo>& meshInfos) {
+		meshInfos.resize(meshRanges.size() + meshLods.size());
+		for (size_t m = 0; m < meshRanges.size(); ++m) {
+			const MeshRange& range = meshRanges[m];
+			glm::vec3 lo(std::numeric_limits<float>::max()), hi(-std::numeric_limits<float>::max());
+			for (uint32_t v = 0; v < range.vertexCount; ++v) {
+				lo = glm::min(lo, geometry.vertices[range.firstVertex + v].pos);
+				hi = glm::max(hi, geometry.vertices[range.firstVertex + v].pos);
+			}
+			if (range.vertexCount == 0) lo = hi = glm::vec3(0.0f);
+
+			MeshInfo& info = meshInfos[m];
+			info.boundsMin = lo;
+			info.boundsScale = glm::max(hi - lo, glm::vec3(1e-20f)) / QUANTIZE_MAX;
+			info.materialIndex = range.materialIndex;
+			info.firstIndex = range.firstIndex;
+		}
+		for (size_t l = 0; l < meshLods.size(); ++l) {
+			MeshInfo& info = meshInfos[meshRanges.size() + l];
+			info = meshInfos[meshLods[l].mesh];
+			info.firstIndex = meshLods[l].firstIndex;
+		}
+	}
+
+	void encodeCompactVertices(const GeometryView& geometry, const std::vector<MeshRange>& meshRanges,
+		const std::vector<MeshInfo>& meshInfos, CompactVertex* dst, ThreadPool* pool) {
+
+		struct EncodeTask {
+			uint32_t mesh;
+			uint32_t begin;
+			uint32_t end;
+		};
+
+		std::vector<EncodeTask> tasks;
+		for (uint32_t m = 0; m < meshRanges.size(); ++m)
+			for (uint32_t b = 0; b < meshRanges[m].vertexCount; b += MESH_CONVERT_CHUNK)
+				tasks.push_back({ m, b, std::min(b + MESH_CONVERT_CHUNK, meshRanges[m].vertexCount) });
+
+		auto encode = [&](size_t t) {
+			const EncodeTask& task = tasks[t];
+			const MeshRange& range = meshRanges[task.mesh];
+			const MeshInfo& info = meshInfos[task.mesh];
+			const glm::vec3 invScale = 1.0f / info.boundsScale;
+
+			for (uint32_t v = range.firstVertex + task.begin; v < range.firstVertex + task.end; ++v) {
+				const Vertex& src = geometry.vertices[v];
+				CompactVertex out;
+				glm::vec3 q = glm::clamp(glm::round((src.pos - info.boundsMin) * invScale), glm::vec3(0.0f), glm::vec3(QUANTIZE_MAX));
+				out.pos[0] = static_cast<uint16_t>(q.x);
+				out.pos[1] = static_cast<uint16_t>(q.y);
+				out.pos[2] = static_cast<uint16_t>(q.z);
+				out.mesh = static_cast<uint16_t>(task.mesh);
+				out.normal = packOctNormal(src.normal);
+				out.tangent = packOctTangent(src.tangent);
+				out.texCoord = glm::packHalf2x16(src.texCoord);
+				// staging memory is write combined, one store per vertex
+				memcpy(dst + v, &out, sizeof(CompactVertex));
+			}
+		};
+
+		if (pool) pool->parallelFor(tasks.size(), encode);
+		else for (size_t t = 0; t < tasks.size(); ++t) encode(t);
+	}
+
+	// tightly packed float3 copy of the positions, the BLAS input, and the raster preview's pos when the attributes are split
+	// both layouts fill it from the same vertices
+	void MainVulkApplication::createPositionBuffer() {
+		uploadBuffer(sizeof(glm::vec3) * geometry.vertexCount, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | RT_GEOMETRY_BUFFER_USAGE, positionBuffer, positionBufferMemory, MemoryCategory::Vertex,
+			[&](void* data) {
+				glm::vec3* dst = static_cast<glm::vec3*>(data);
+				for (size_t v = 0; v < geometry.vertexCount; ++v) dst[v] = geometry.vertices[v].pos;
+			});
+	}
+
+	// indexed by gl_InstanceCustomIndexEXT, one entry per submesh and LOD level
+	void MainVulkApplication::createMeshInfoBuffer() {
+		buildMeshInfos(geometry, meshRanges, meshLods, meshInfos);
+		if (meshInfos.empty()) return;
+		uploadBuffer(sizeof(MeshInfo) * meshInfos.size(), RT_GEOMETRY_BUFFER_USAGE, meshInfoBuffer, meshInfoBufferMemory, MemoryCategory::Vertex,
+			[&](void* data) {
+				memcpy(data, meshInfos.data(), sizeof(MeshInfo) * meshInfos.size());
+			});
+	}
+
+	bool MainVulkApplication::createCompactVertexBuffer() {
+		static_assert(sizeof(MeshInfo) == 32, "MeshInfo must match RT_vertex_decode.glsl");
+
+		// meshes are addressed by a 16 bit index
+		if (meshRanges.size() > 0xFFFF) {
+			std::cerr << "compact vertices : " << meshRanges.size() << " meshes do not fit, using the full layout" << std::endl;
+			return false;
+		}
+
+		auto startTime = std::chrono::high_resolution_clock::now();
+		if (!workerPool) workerPool = std::make_unique<ThreadPool>();
+
+		createMeshInfoBuffer();
+		uploadBuffer(sizeof(CompactVertex) * geometry.vertexCount, RT_GEOMETRY_BUFFER_USAGE, vertexBuffer, vertexBufferMemory, MemoryCategory::Vertex,
+			[&](void* data) {
+				encodeCompactVertices(geometry, meshRanges, meshInfos, static_cast<CompactVertex*>(data), workerPool.get());
+			});
+		createPositionBuffer();
+		vertexLayout = VertexLayout::Compact;
+
+		const double mb = 1.0 / (1024.0 * 1024.0);
+		std::cout << "compact vertices : " << elapsedMs(startTime, std::chrono::high_resolution_clock::now()) << " ms, "
+			<< geometry.vertexCount * sizeof(CompactVertex) * mb << " MB + positions "
+			<< geometry.vertexCount * sizeof(glm::vec3) * mb << " MB (full layout " << geometry.vertexCount * sizeof(Vertex) * mb << " MB)" << std::endl;
+		return true;
+	}
+}
+
+#endif
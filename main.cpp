@@ -55,7 +55,7 @@ namespace VkApplication {
 		_app->ubo.proj[1][1] *= -1.0f;
 		glm::mat3 viewMatrix3x3(_app->ubo.view * _app->ubo.model);
 		_app->ubo.normalMatrix = glm::inverseTranspose(viewMatrix3x3);
-		_app->ubo.lightPos = LightPosition;
+		_app->ufo.lightPos = LightPosition;
 
 		_app->ufo.Ambient = ambientLight;
 		_app->ufo.LightColor = lightColor;
@@ -79,21 +79,25 @@ namespace VkApplication {
 		}
 
 		if (changeLightPos[0] == 1) {
-			_app->ubo.lightPos.x += lightPositionx;
+			_app->ufo.lightPos.x += lightPositionx;
 			changeLightPos[0] = 0;
 		}
 		if (changeLightPos[1] == 1) {
-			_app->ubo.lightPos.y += lightPositiony;
+			_app->ufo.lightPos.y += lightPositiony;
 			changeLightPos[1] = 0;
 		}
 		if (changeLightPos[2] == 1) {
-			_app->ubo.lightPos.z += lightPositionz;
+			_app->ufo.lightPos.z += lightPositionz;
 			changeLightPos[2] = 0;
 		}
 		if (kick == true) {
 			_app->keyControl.kickParticle = true;
 			kick = false;
 		}
+		if (dumpMemory == true) {
+			_app->dumpMemoryReport("memory_report.json");
+			dumpMemory = false;
+		}
 	}
 
 
@@ -114,7 +118,14 @@ namespace VkApplication {
 	}
 }
 
-int main() {
+int main(int argc, char** argv) {
+
+	if (enableBenchmarks) {
+		VkApplication::benchmarkExecutable = argv[0];
+		// child of benchmarkGLBImport, one import and no window
+		if (argc >= 3 && std::string(argv[1]) == "--import-rss")
+			return VkApplication::importPeakRss(argv[2], argc >= 4 ? argv[3] : VkApplication::MODEL_PATH);
+	}
 
 	VkApplication::MainVulkApplication* vkApp_ = VkApplication::MainVulkApplication::GetInstance();
 
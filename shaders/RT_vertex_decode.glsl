@@ -0,0 +1,61 @@
+#ifndef RT_VERTEX_DECODE_GLSL
+#define RT_VERTEX_DECODE_GLSL
+
+// decode side of VulkanVertexFormat.hpp, CompactVertex is read as 5 uints
+//   word 0 : pos.x | pos.y << 16
+//   word 1 : pos.z | mesh << 16
+//   word 2 : octahedral normal, snorm16x2
+//   word 3 : octahedral tangent, snorm16x2, bit 0 = negative handedness
+//   word 4 : uv, half2
+
+#define COMPACT_VERTEX_WORDS 5
+
+// one entry per submesh followed by one per LOD level, a hit reads meshInfos[gl_InstanceCustomIndexEXT] for its
+// material and meshInfos[...].firstIndex + 3 * gl_PrimitiveID for its triangle
+struct MeshInfo {
+	vec3 boundsMin;
+	uint materialIndex;
+	vec3 boundsScale;
+	uint firstIndex;
+};
+
+struct HitVertex {
+	vec3 pos;
+	vec3 normal;
+	vec4 tangent;
+	vec2 texCoord;
+};
+
+uint compactVertexMesh(uint word1) {
+	return word1 >> 16;
+}
+
+vec3 octDecode(vec2 e) {
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
+HitVertex decodeCompactVertex(uint w0, uint w1, uint w2, uint w3, uint w4, MeshInfo mesh) {
+	HitVertex v;
+	uvec3 q = uvec3(w0 & 0xFFFFu, w0 >> 16, w1 & 0xFFFFu);
+	v.pos = mesh.boundsMin + vec3(q) * mesh.boundsScale;
+	v.normal = octDecode(unpackSnorm2x16(w2));
+	v.tangent = vec4(octDecode(unpackSnorm2x16(w3 & ~1u)), (w3 & 1u) != 0u ? -1.0 : 1.0);
+	v.texCoord = unpackHalf2x16(w4);
+	return v;
+}
+
+HitVertex interpolateHitVertex(HitVertex a, HitVertex b, HitVertex c, vec2 hitAttribs) {
+	vec3 bary = vec3(1.0 - hitAttribs.x - hitAttribs.y, hitAttribs.x, hitAttribs.y);
+	HitVertex v;
+	v.pos = a.pos * bary.x + b.pos * bary.y + c.pos * bary.z;
+	v.normal = normalize(a.normal * bary.x + b.normal * bary.y + c.normal * bary.z);
+	v.tangent = vec4(normalize(a.tangent.xyz * bary.x + b.tangent.xyz * bary.y + c.tangent.xyz * bary.z), a.tangent.w);
+	v.texCoord = a.texCoord * bary.x + b.texCoord * bary.y + c.texCoord * bary.z;
+	return v;
+}
+
+#endif